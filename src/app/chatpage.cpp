@@ -34,6 +34,9 @@
 #include "textdocument.h"
 #include "pluginloader.h"
 #include "textbrowser.h"
+#include "messageview.h"
+#include "formatcache.h"
+#include "searchindex.h"
 #include "bufferview.h"
 #include "textinput.h"
 #include "splitview.h"
@@ -56,9 +59,26 @@
 #include <QSettings>
 #include <Irc>
 
+// documents pass a message on to their clones, so only the origin is fed
+static void receiveMessage(IrcBuffer* buffer, IrcMessage* message)
+{
+    foreach (TextDocument* doc, buffer->findChildren<TextDocument*>()) {
+        if (!doc->isClone()) {
+            doc->receiveMessage(message);
+            break;
+        }
+    }
+}
+
+static BufferView::ViewMode viewModeFor(const QString& name)
+{
+    return name == "list" ? BufferView::ListMode : BufferView::TextMode;
+}
+
 ChatPage::ChatPage(QWidget* parent) : QSplitter(parent)
 {
     d.currentBuffer = 0;
+    d.scrollback = 100000;
     d.finder = new Finder(this);
     d.splitView = new SplitView(this);
     d.treeWidget = new TreeWidget(this);
@@ -141,6 +161,8 @@ QByteArray ChatPage::saveSettings() const
     QVariantMap settings;
     settings.insert("theme", d.theme.name());
     settings.insert("timestamp", d.timestamp);
+    settings.insert("view", d.view);
+    settings.insert("scrollback", d.scrollback);
     settings.insert("tree", d.treeWidget->saveState());
 
     QByteArray data;
@@ -160,6 +182,14 @@ void ChatPage::restoreSettings(const QByteArray& data)
 
     d.timestamp = settings.value("timestamp", "[hh:mm:ss]").toString();
     setTheme(settings.value("theme", "Cute").toString());
+
+    d.scrollback = settings.value("scrollback", 100000).toInt();
+    foreach (TextDocument* doc, d.documents)
+        doc->setScrollbackLimit(d.scrollback);
+
+    d.view = settings.value("view", "text").toString();
+    foreach (BufferView* view, d.splitView->views())
+        view->setViewMode(viewModeFor(d.view));
 }
 
 QByteArray ChatPage::saveState() const
@@ -220,7 +250,7 @@ bool ChatPage::commandFilter(IrcCommand* command)
         const QString cmd = command->parameters().value(0);
         const QStringList params = command->parameters().mid(1);
         if (cmd == "CLEAR") {
-            d.splitView->currentView()->textBrowser()->clear();
+            d.splitView->currentView()->clear();
             return true;
         } else if (cmd == "CLOSE") {
             IrcBuffer* buffer = currentBuffer();
@@ -275,12 +305,68 @@ bool ChatPage::commandFilter(IrcCommand* command)
                         doc->setTimeStampFormat(value);
                 }
             } else if (!key.compare("font")) {
-                QFont f = d.splitView->currentView()->textBrowser()->font();
+                QFont f = d.splitView->currentView()->textFont();
                 if (value.isEmpty())
                     f.setFamily(font().family());
                 else
                     f.setFamily(value);
-                d.splitView->currentView()->textBrowser()->setFont(f);
+                d.splitView->currentView()->setTextFont(f);
+            } else if (!key.compare("scrollback")) {
+                // number of lines per buffer kept on disk behind the in-memory window
+                bool ok = false;
+                const int limit = value.toInt(&ok);
+                if (ok && limit >= 0) {
+                    d.scrollback = limit;
+                    foreach (TextDocument* doc, d.documents)
+                        doc->setScrollbackLimit(limit);
+                }
+            } else if (!key.compare("view")) {
+                // list mode renders only the visible lines, which scales to much deeper scrollback
+                if (value == "list" || value == "text") {
+                    d.view = value;
+                    foreach (BufferView* view, d.splitView->views())
+                        view->setViewMode(viewModeFor(value));
+                }
+            } else if (!key.compare("layouts")) {
+                // reports how often appending lines forces a layout
+                IrcBuffer* buffer = currentBuffer();
+                if (buffer) {
+                    const QString info = tr("Forced layouts: %1 per second").arg(TextDocument::forcedLayouts());
+                    IrcMessage* message = IrcMessage::fromParameters("communi", "NOTICE", QStringList() << buffer->title() << info, buffer->connection());
+                    receiveMessage(buffer, message);
+                    delete message;
+                }
+            } else if (!key.compare("searchindex")) {
+                // lines kept for the global search, see Ctrl+Shift+F
+                SearchIndex* index = SearchIndex::instance();
+                bool ok = false;
+                const int capacity = value.toInt(&ok);
+                if (ok && capacity >= 0)
+                    index->setCapacity(capacity);
+                IrcBuffer* buffer = currentBuffer();
+                if (buffer) {
+                    const QString info = tr("Search index: %1 lines, %2 tokens, capacity %3")
+                                            .arg(index->count()).arg(index->tokenCount()).arg(index->capacity());
+                    IrcMessage* message = IrcMessage::fromParameters("communi", "NOTICE", QStringList() << buffer->title() << info, buffer->connection());
+                    receiveMessage(buffer, message);
+                    delete message;
+                }
+            } else if (!key.compare("formatcache")) {
+                // reports how much duplicate formatting the cache saves
+                FormatCache* cache = FormatCache::instance();
+                bool ok = false;
+                const int capacity = value.toInt(&ok);
+                if (ok && capacity >= 0)
+                    cache->setCapacity(capacity);
+                IrcBuffer* buffer = currentBuffer();
+                if (buffer) {
+                    const QString info = tr("Format cache: %1 hits, %2 misses (%3% hit rate), capacity %4")
+                                            .arg(cache->hits()).arg(cache->misses())
+                                            .arg(qRound(cache->hitRate() * 100)).arg(cache->capacity());
+                    IrcMessage* message = IrcMessage::fromParameters("communi", "NOTICE", QStringList() << buffer->title() << info, buffer->connection());
+                    receiveMessage(buffer, message);
+                    delete message;
+                }
             }
             return true;
         }
@@ -397,6 +483,7 @@ void ChatPage::setupDocument(TextDocument* document)
     d.documents.insert(document);
 
     document->setTimeStampFormat(d.timestamp);
+    document->setScrollbackLimit(d.scrollback);
     document->setStyleSheet(d.theme.style());
 
     connect(document, SIGNAL(messageReceived(IrcMessage*)), this, SLOT(onMessageReceived(IrcMessage*)));
@@ -412,9 +499,11 @@ void ChatPage::addView(BufferView* view)
 
 #if QT_VERSION >= 0x050300 && !defined(Q_OS_MAC)
     view->textBrowser()->verticalScrollBar()->setStyle(ScrollBarStyle::expanding());
+    view->messageView()->verticalScrollBar()->setStyle(ScrollBarStyle::expanding());
     view->listView()->verticalScrollBar()->setStyle(ScrollBarStyle::expanding());
 #endif
 
+    view->setViewMode(viewModeFor(d.view));
     view->textInput()->setParser(createParser(view));
     connect(view, SIGNAL(bufferClosed(IrcBuffer*)), this, SLOT(closeBuffer(IrcBuffer*)));
     connect(view, SIGNAL(cloned(TextDocument*)), this, SLOT(setupDocument(TextDocument*)));
@@ -509,8 +598,7 @@ void ChatPage::onSocketError()
             if (buffer) {
                 QStringList params = QStringList() << connection->nickName() << connection->socket()->errorString();
                 IrcMessage* message = IrcMessage::fromParameters(buffer->title(), QString::number(Irc::ERR_UNKNOWNERROR), params, connection);
-                foreach (TextDocument* doc, buffer->findChildren<TextDocument*>())
-                    doc->receiveMessage(message);
+                receiveMessage(buffer, message);
                 delete message;
 
                 TreeItem* item = d.treeWidget->connectionItem(connection);
@@ -531,8 +619,7 @@ void ChatPage::onSecureError()
             if (buffer) {
                 QStringList params = QStringList() << connection->nickName() << tr("Unable to establish secure connection.");
                 IrcMessage* message = IrcMessage::fromParameters(buffer->title(), QString::number(Irc::ERR_UNKNOWNERROR), params, connection);
-                foreach (TextDocument* doc, buffer->findChildren<TextDocument*>())
-                    doc->receiveMessage(message);
+                receiveMessage(buffer, message);
                 delete message;
             }
         }
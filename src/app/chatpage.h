@@ -104,6 +104,8 @@ private:
     struct Private {
         Finder* finder;
         ThemeInfo theme;
+        QString view;
+        int scrollback;
         QString timestamp;
         QStringList chans;
         SplitView* splitView;
@@ -31,16 +31,21 @@
 #include <QGraphicsOpacityEffect>
 #include <QStylePainter>
 #include <QStyleOption>
+#include <QWidgetAction>
+#include <QActionGroup>
 #include <QApplication>
 #include <QHBoxLayout>
 #include <QKeyEvent>
 #include <QEvent>
+#include <QMenu>
 
 AbstractFinder::AbstractFinder(QWidget* parent) : QWidget(parent)
 {
     d.offset = -1;
     d.error = false;
-    d.filter = false;
+    d.mode = Search;
+    d.menuButton = 0;
+    d.modes = 0;
 
     parent->installEventFilter(this);
     setGraphicsEffect(new QGraphicsOpacityEffect(this));
@@ -118,27 +123,40 @@ QLineEdit *AbstractFinder::lineEdit() const
     return d.lineEdit;
 }
 
-bool AbstractFinder::isFilter() const
+AbstractFinder::Mode AbstractFinder::mode() const
 {
-    return d.filter;
+    return d.mode;
 }
 
-void AbstractFinder::setFilter(bool enabled)
+void AbstractFinder::setMode(Mode mode)
 {
-    if (d.filter != enabled) {
-        d.filter = enabled;
-        d.prevButton->setVisible(!enabled);
-        d.nextButton->setVisible(!enabled);
-        if (enabled) {
-            filter(d.lineEdit->text());
-        } else {
+    if (d.mode != mode) {
+        const Mode previous = d.mode;
+        d.mode = mode;
+        d.prevButton->setVisible(mode == Search);
+        d.nextButton->setVisible(mode == Search);
+        if (previous == Filter)
             filter(QString());
-            find(d.lineEdit->text());
-        }
-        emit filterChanged(enabled);
+        else if (previous == Query)
+            query(QString());
+        textEdited();
+        emit modeChanged(mode);
     }
 }
 
+bool AbstractFinder::isFilter() const
+{
+    return d.mode == Filter;
+}
+
+void AbstractFinder::setFilter(bool enabled)
+{
+    if (enabled)
+        setMode(Filter);
+    else if (d.mode == Filter)
+        setMode(Search);
+}
+
 bool AbstractFinder::eventFilter(QObject* object, QEvent* event)
 {
     Q_UNUSED(object);
@@ -191,10 +209,60 @@ void AbstractFinder::animateHide()
     connect(animation, SIGNAL(destroyed()), this, SLOT(deleteLater()));
 }
 
+// the search, filter and query modes of the message finders
+void AbstractFinder::addModeMenu()
+{
+    // FIXME: QMenu(this) breaks lineEdit refresh for some reason
+    QMenu *menu = new QMenu();
+    QAction *search = menu->addAction(tr("Search"));
+    search->setCheckable(true);
+    search->setChecked(d.mode == Search);
+    search->setData(Search);
+    QAction *filter = menu->addAction(tr("Filter"));
+    filter->setCheckable(true);
+    filter->setChecked(d.mode == Filter);
+    filter->setData(Filter);
+    QAction *query = menu->addAction(tr("Query"));
+    query->setCheckable(true);
+    query->setChecked(d.mode == Query);
+    query->setData(Query);
+    query->setToolTip(tr("nick:name type:join,part after:2h before:12:00 is:highlight /regexp/ text"));
+    d.modes = new QActionGroup(this);
+    d.modes->setExclusive(true);
+    d.modes->addAction(search);
+    d.modes->addAction(filter);
+    d.modes->addAction(query);
+    connect(d.modes, SIGNAL(triggered(QAction*)), this, SLOT(changeMode(QAction*)));
+    connect(this, SIGNAL(modeChanged(int)), this, SLOT(updateMenu(int)));
+
+    d.menuButton = new QToolButton(d.lineEdit);
+    d.menuButton->setObjectName("filter");
+    d.menuButton->setMenu(menu);
+    d.menuButton->setPopupMode(QToolButton::InstantPopup);
+    QWidgetAction *action = new QWidgetAction(this);
+    action->setDefaultWidget(d.menuButton);
+    d.lineEdit->addAction(action, QLineEdit::LeadingPosition);
+}
+
 void AbstractFinder::textEdited()
 {
-    if (d.filter)
+    if (d.mode == Filter)
         filter(d.lineEdit->text());
+    else if (d.mode == Query)
+        query(d.lineEdit->text());
     else
         find(d.lineEdit->text());
 }
+
+void AbstractFinder::changeMode(QAction* action)
+{
+    setMode(Mode(action->data().toInt()));
+}
+
+void AbstractFinder::updateMenu(int mode)
+{
+    foreach (QAction* action, d.modes->actions()) {
+        if (action->data().toInt() == mode)
+            action->setChecked(true);
+    }
+}
@@ -32,6 +32,9 @@
 #include <QLineEdit>
 #include <QToolButton>
 
+class QAction;
+class QActionGroup;
+
 class AbstractFinder : public QWidget
 {
     Q_OBJECT
@@ -43,6 +46,8 @@ public:
     explicit AbstractFinder(QWidget* parent);
     ~AbstractFinder();
 
+    enum Mode { Search, Filter, Query };
+
     QString text() const;
     void setText(const QString& text);
 
@@ -54,6 +59,9 @@ public:
 
     QLineEdit *lineEdit() const;
 
+    Mode mode() const;
+    void setMode(Mode mode);
+
     bool isFilter() const;
 
 public slots:
@@ -72,26 +80,34 @@ public slots:
 signals:
     void returnPressed();
     void destroyed(AbstractFinder* input);
-    void filterChanged(bool filter);
+    void modeChanged(int mode);
 
 protected slots:
     virtual void filter(const QString&) { }
+    virtual void query(const QString&) { }
     virtual void find(const QString& text, bool forward = false, bool backward = false, bool typed = true) = 0;
 
 protected slots:
     virtual void relocate() = 0;
 
+protected:
+    void addModeMenu();
+
 private slots:
     void textEdited();
+    void changeMode(QAction* action);
+    void updateMenu(int mode);
 
 private:
     struct Private {
         int offset;
         bool error;
-        bool filter;
+        Mode mode;
         QLineEdit* lineEdit;
         QToolButton* prevButton;
         QToolButton* nextButton;
+        QToolButton* menuButton;
+        QActionGroup* modes;
     } d;
 };
 
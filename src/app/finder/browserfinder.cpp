@@ -28,39 +28,26 @@
 #include "browserfinder.h"
 #include "textbrowser.h"
 #include "textdocument.h"
-#include <QWidgetAction>
-#include <QActionGroup>
+#include <QTimerEvent>
+#include <QBitArray>
 #include <QTextBlock>
+#include <QScrollBar>
 #include <QDebug>
-#include <QMenu>
+#include <algorithm>
+
+// typing is folded into a single search after a short pause
+static const int Delay = 150;
 
 BrowserFinder::BrowserFinder(TextBrowser* browser) : AbstractFinder(browser)
 {
     d.textBrowser = browser;
+    d.revision = -1;
+    d.filterRevision = -1;
     connect(browser, SIGNAL(documentChanged(TextDocument*)), this, SLOT(deleteLater()));
+    connect(browser->verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(updateHighlights()));
     connect(this, SIGNAL(returnPressed()), this, SLOT(findNext()));
 
-    // FIXME: QMenu(this) breaks lineEdit refresh for some reason
-    QMenu *menu = new QMenu();
-    QAction *search = menu->addAction(tr("Search"));
-    search->setCheckable(true);
-    search->setChecked(true);
-    QAction *filter = menu->addAction(tr("Filter"));
-    connect(filter, SIGNAL(toggled(bool)), this, SLOT(setFilter(bool)));
-    connect(this, SIGNAL(filterChanged(bool)), filter, SLOT(setChecked(bool)));
-    filter->setCheckable(true);
-    QActionGroup *group = new QActionGroup(this);
-    group->setExclusive(true);
-    group->addAction(search);
-    group->addAction(filter);
-
-    d.menuButton = new QToolButton(lineEdit());
-    d.menuButton->setObjectName("filter");
-    d.menuButton->setMenu(menu);
-    d.menuButton->setPopupMode(QToolButton::InstantPopup);
-    QWidgetAction *action = new QWidgetAction(this);
-    action->setDefaultWidget(d.menuButton);
-    lineEdit()->addAction(action, QLineEdit::LeadingPosition);
+    addModeMenu();
 }
 
 BrowserFinder::~BrowserFinder()
@@ -71,20 +58,16 @@ void BrowserFinder::setVisible(bool visible)
 {
     AbstractFinder::setVisible(visible);
     if (!visible && d.textBrowser) {
+        d.timer.stop();
+        d.rescan.stop();
+        d.filter = MessageQuery();
         QTextCursor cursor = d.textBrowser->textCursor();
         if (cursor.hasSelection()) {
             cursor.clearSelection();
             d.textBrowser->setTextCursor(cursor);
         }
         d.textBrowser->setExtraSelections(QList<QTextEdit::ExtraSelection>());
-
-        QTextDocument* doc = d.textBrowser->document();
-        for (QTextBlock block = doc->begin(); block != doc->end(); block = block.next()) {
-            if (!block.isVisible()) {
-                block.setVisible(true);
-                doc->markContentsDirty(block.position(), block.length());
-            }
-        }
+        updateVisibility(QString());
     }
 }
 
@@ -93,105 +76,251 @@ void BrowserFinder::find(const QString& text, bool forward, bool backward, bool
     if (!d.textBrowser)
         return;
 
-    QTextDocument* doc = d.textBrowser->document();
-    QTextCursor cursor = d.textBrowser->textCursor();
+    if (typed) {
+        if (!isVisible())
+            animateShow();
+        d.timer.start(Delay, this);
+        return;
+    }
 
-    bool error = false;
-    QTextDocument::FindFlags options;
+    // stepping right after typing does not wait for the pause
+    if (d.timer.isActive()) {
+        d.timer.stop();
+        search(text, false, false, true);
+    }
+    search(text, forward, backward, false);
+}
 
-    if (cursor.hasSelection())
-        cursor.setPosition(typed ? cursor.selectionEnd() : forward ? cursor.position() : cursor.anchor(), QTextCursor::MoveAnchor);
+void BrowserFinder::timerEvent(QTimerEvent* event)
+{
+    if (event->timerId() == d.timer.timerId()) {
+        d.timer.stop();
+        if (mode() == Query)
+            runQuery(text());
+        else
+            search(text(), false, false, true);
+    } else if (event->timerId() == d.rescan.timerId()) {
+        d.rescan.stop();
+        if (!d.query.isEmpty())
+            collect(d.query);
+        updateHighlights();
+    } else {
+        AbstractFinder::timerEvent(event);
+    }
+}
 
+// steps through the sorted match offsets instead of searching the
+// document again, wrapping around at either end
+void BrowserFinder::search(const QString& text, bool forward, bool backward, bool typed)
+{
+    Q_UNUSED(backward);
+    if (!d.textBrowser)
+        return;
+
+    QTextDocument* doc = d.textBrowser->document();
+    QTextCursor cursor = d.textBrowser->textCursor();
     QTextCursor newCursor = cursor;
-    QList<QTextEdit::ExtraSelection> extraSelections;
+    bool error = false;
 
+    collect(text);
     if (!text.isEmpty()) {
-        if (typed || backward)
-            options |= QTextDocument::FindBackward;
-
-        newCursor = doc->find(text, cursor, options);
-
-        if (newCursor.isNull()) {
-            QTextCursor ac(doc);
-            ac.movePosition(options & QTextDocument::FindBackward
-                            ? QTextCursor::End : QTextCursor::Start);
-            newCursor = doc->find(text, ac, options);
-            if (newCursor.isNull()) {
-                error = true;
-                newCursor = cursor;
+        if (d.matches.isEmpty()) {
+            error = true;
+        } else {
+            const int length = text.length();
+            QVector<int>::const_iterator it;
+            if (forward) {
+                it = std::lower_bound(d.matches.constBegin(), d.matches.constEnd(), cursor.position());
+                if (it == d.matches.constEnd())
+                    it = d.matches.constBegin();
+            } else {
+                const int from = typed ? cursor.selectionEnd() : cursor.anchor();
+                it = std::upper_bound(d.matches.constBegin(), d.matches.constEnd(), from - length);
+                if (it == d.matches.constBegin())
+                    it = d.matches.constEnd();
+                --it;
             }
-        }
-
-        QTextCursor findCursor(doc);
-        while (!(findCursor = doc->find(text, findCursor)).isNull()) {
-            QTextEdit::ExtraSelection extra;
-            extra.format.setBackground(Qt::yellow);
-            extra.cursor = findCursor;
-            extraSelections.append(extra);
+            newCursor = QTextCursor(doc);
+            newCursor.setPosition(*it);
+            newCursor.setPosition(*it + length, QTextCursor::KeepAnchor);
         }
     }
 
     if (!isVisible())
         animateShow();
     d.textBrowser->setTextCursor(newCursor);
-    d.textBrowser->setExtraSelections(extraSelections);
+    updateHighlights();
     setError(error);
 }
 
-void BrowserFinder::filter(const QString& text)
+// match offsets are collected once per query and only narrowed down as
+// the query grows, until the document changes
+void BrowserFinder::collect(const QString& text)
 {
-    if (!d.textBrowser)
+    QTextDocument* doc = d.textBrowser->document();
+    if (text.isEmpty()) {
+        d.query.clear();
+        d.matches.clear();
         return;
+    }
 
-    QTextDocument* doc = d.textBrowser->document();
+    const bool current = d.revision == doc->revision();
+    if (current && !d.query.isEmpty() && text.startsWith(d.query, Qt::CaseInsensitive)) {
+        if (text.length() != d.query.length()) {
+            QVector<int> matches;
+            foreach (int pos, d.matches) {
+                if (d.plain.midRef(pos, text.length()).compare(text, Qt::CaseInsensitive) == 0)
+                    matches += pos;
+            }
+            d.matches = matches;
+        }
+    } else {
+        if (!current) {
+            d.plain = doc->toPlainText();
+            d.revision = doc->revision();
+        }
+        // overlapping matches, so that a longer query finds them all
+        d.matches.clear();
+        int pos = 0;
+        while ((pos = d.plain.indexOf(text, pos, Qt::CaseInsensitive)) != -1)
+            d.matches += pos++;
+    }
+    d.query = text;
+}
+
+// only the matches on screen are highlighted, however many there are;
+// every incoming line scrolls, so the document is not searched again
+// here but at most once per pause after it has changed
+void BrowserFinder::updateHighlights()
+{
+    if (!d.textBrowser || !isVisible())
+        return;
 
-    bool error = true;
     QList<QTextEdit::ExtraSelection> extraSelections;
+    if (!d.query.isEmpty()) {
+        QTextDocument* doc = d.textBrowser->document();
+        if (d.revision != doc->revision() && !d.rescan.isActive())
+            d.rescan.start(Delay, this);
 
-    if (!text.isEmpty()) {
-        QTextCursor prevCursor(doc);
-        QTextCursor findCursor(doc);
-        while (!(findCursor = doc->find(text, findCursor)).isNull()) {
-            error = false;
-            findCursor.block().setVisible(true);
-            doc->markContentsDirty(findCursor.block().position(), findCursor.block().length());
+        const QWidget* viewport = d.textBrowser->viewport();
+        const int first = d.textBrowser->cursorForPosition(QPoint(0, 0)).position();
+        const int last = d.textBrowser->cursorForPosition(QPoint(viewport->width(), viewport->height())).position();
+
+        QVector<int>::const_iterator it = std::lower_bound(d.matches.constBegin(), d.matches.constEnd(), first - d.query.length());
+        for (; it != d.matches.constEnd() && *it <= last; ++it) {
             QTextEdit::ExtraSelection extra;
             extra.format.setBackground(Qt::yellow);
-            extra.cursor = findCursor;
+            extra.cursor = QTextCursor(doc);
+            extra.cursor.setPosition(*it);
+            extra.cursor.setPosition(*it + d.query.length(), QTextCursor::KeepAnchor);
             extraSelections.append(extra);
-            while (prevCursor.blockNumber() < findCursor.blockNumber()) {
-                QTextBlock block = prevCursor.block();
-                block.setVisible(false);
-                doc->markContentsDirty(block.position(), block.length());
-                if (!prevCursor.movePosition(QTextCursor::NextBlock))
-                    break;
-            }
-            prevCursor = findCursor;
-            prevCursor.movePosition(QTextCursor::NextBlock);
-        }
-        while (!prevCursor.atEnd()) {
-            QTextBlock block = prevCursor.block();
-            if (block.isVisible()) {
-                block.setVisible(false);
-                doc->markContentsDirty(block.position(), block.length());
-            }
-            if (!prevCursor.movePosition(QTextCursor::NextBlock))
-                break;
         }
+    }
+    d.textBrowser->setExtraSelections(extraSelections);
+}
+
+void BrowserFinder::filter(const QString& text)
+{
+    if (!d.textBrowser)
+        return;
+
+    updateVisibility(text);
+
+    if (!isVisible())
+        animateShow();
+    updateHighlights();
+    setError(!text.isEmpty() && d.matches.isEmpty());
+}
+
+// queries are parsed and run after the same pause as searches, except
+// for clearing one which takes effect right away
+void BrowserFinder::query(const QString& text)
+{
+    if (!d.textBrowser)
+        return;
+
+    if (text.isEmpty()) {
+        d.timer.stop();
+        runQuery(text);
     } else {
-        error = false;
-        for (QTextBlock block = doc->begin(); block != doc->end(); block = block.next()) {
-            if (!block.isVisible()) {
-                block.setVisible(true);
-                doc->markContentsDirty(block.position(), block.length());
+        if (!isVisible())
+            animateShow();
+        d.timer.start(Delay, this);
+    }
+}
+
+// structured queries run over the messages behind the blocks instead of
+// the rendered text; the state stays with this finder, not the document.
+// a narrower query of an unchanged document only re-checks shown blocks
+void BrowserFinder::runQuery(const QString& text)
+{
+    TextDocument* doc = d.textBrowser->document();
+    const MessageQuery query(text);
+    const bool narrower = d.filterRevision == doc->revision() && query.refines(d.filter);
+
+    bool found = query.isEmpty();
+    QBitArray visible(doc->blockCount(), true);
+    if (!query.isEmpty()) {
+        int number = 0;
+        for (QTextBlock block = doc->begin(); block.isValid(); block = block.next(), ++number) {
+            if (narrower && !block.isVisible()) {
+                visible.clearBit(number);
+                continue;
             }
+            const MessageData data = doc->message(block);
+            if (data.isEmpty() || !query.matches(data, doc->isHighlighted(number)))
+                visible.clearBit(number);
+            else
+                found = true;
         }
     }
+    showBlocks(visible);
+    d.filter = query;
+    d.filterRevision = doc->revision();
 
+    collect(QString());
     if (!isVisible())
         animateShow();
-    d.textBrowser->setExtraSelections(extraSelections);
-    setError(error);
+    d.textBrowser->setExtraSelections(QList<QTextEdit::ExtraSelection>());
+    lineEdit()->setToolTip(query.errorString());
+    setError(!query.isValid() || !found);
+}
+
+void BrowserFinder::updateVisibility(const QString& text)
+{
+    TextDocument* doc = d.textBrowser->document();
+    collect(text);
+
+    // a visibility bit per block from the sorted match offsets
+    QBitArray visible(doc->blockCount(), text.isEmpty());
+    QVector<int>::const_iterator it = d.matches.constBegin();
+    int number = 0;
+    for (QTextBlock block = doc->begin(); block.isValid() && it != d.matches.constEnd(); block = block.next(), ++number) {
+        const int end = block.position() + block.length();
+        for (; it != d.matches.constEnd() && *it < end; ++it)
+            visible.setBit(number);
+    }
+    showBlocks(visible);
+}
+
+// flips only the blocks whose visibility changes, followed by a single
+// layout invalidation that covers the changed range
+void BrowserFinder::showBlocks(const QBitArray& visible)
+{
+    QTextDocument* doc = d.textBrowser->document();
+    int from = -1;
+    int to = -1;
+    int number = 0;
+    for (QTextBlock block = doc->begin(); block.isValid() && number < visible.count(); block = block.next(), ++number) {
+        if (block.isVisible() != visible.testBit(number)) {
+            block.setVisible(visible.testBit(number));
+            if (from == -1)
+                from = block.position();
+            to = block.position() + block.length();
+        }
+    }
+    if (from != -1)
+        doc->markContentsDirty(from, to - from);
 }
 
 void BrowserFinder::relocate()
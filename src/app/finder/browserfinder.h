@@ -30,7 +30,11 @@
 #define BROWSERFINDER_H
 
 #include "abstractfinder.h"
+#include "messagequery.h"
+#include <QBasicTimer>
+#include <QVector>
 
+class QBitArray;
 class TextBrowser;
 
 class BrowserFinder : public AbstractFinder
@@ -43,15 +47,35 @@ public:
 
     void setVisible(bool visible);
 
+protected:
+    void timerEvent(QTimerEvent* event);
+
 protected slots:
     void find(const QString& text, bool forward = false, bool backward = false, bool typed = true);
     void filter(const QString &text);
+    void query(const QString& text);
     void relocate();
 
+private slots:
+    void updateHighlights();
+
 private:
+    void search(const QString& text, bool forward, bool backward, bool typed);
+    void runQuery(const QString& text);
+    void collect(const QString& text);
+    void updateVisibility(const QString& text);
+    void showBlocks(const QBitArray& visible);
+
     struct Private {
         TextBrowser* textBrowser;
-        QToolButton* menuButton;
+        QBasicTimer timer;
+        QBasicTimer rescan;
+        int revision;
+        QString plain;
+        QString query;
+        QVector<int> matches;
+        MessageQuery filter;
+        int filterRevision;
     } d;
 };
 
@@ -29,6 +29,9 @@
 #include "finder.h"
 #include "chatpage.h"
 #include "browserfinder.h"
+#include "messagefinder.h"
+#include "globalfinder.h"
+#include "messageview.h"
 #include "textbrowser.h"
 #include "treewidget.h"
 #include "treefinder.h"
@@ -36,13 +39,14 @@
 #include "bufferview.h"
 #include "textinput.h"
 #include "listview.h"
+#include "splitview.h"
 #include <QApplication>
 #include <QTimer>
 
 Finder::Finder(ChatPage* page) : QObject(page)
 {
     d.page = page;
-    d.browserFilter = false;
+    d.browserMode = AbstractFinder::Search;
     d.nextShortcut = 0;
     d.prevShortcut = 0;
     d.lastSearch = NoSearch;
@@ -56,11 +60,15 @@ Finder::Finder(ChatPage* page) : QObject(page)
     shortcut = new QShortcut(QKeySequence("Ctrl+U"), page);
     connect(shortcut, SIGNAL(activated()), this, SLOT(searchList()));
 
+    shortcut = new QShortcut(QKeySequence("Ctrl+Shift+F"), page);
+    connect(shortcut, SIGNAL(activated()), this, SLOT(searchGlobal()));
+
     d.cancelShortcut = new QShortcut(Qt::Key_Escape, page);
     d.cancelShortcut->setEnabled(false);
     connect(d.cancelShortcut, SIGNAL(activated()), this, SLOT(cancelTreeSearch()));
     connect(d.cancelShortcut, SIGNAL(activated()), this, SLOT(cancelListSearch()));
     connect(d.cancelShortcut, SIGNAL(activated()), this, SLOT(cancelBrowserSearch()));
+    connect(d.cancelShortcut, SIGNAL(activated()), this, SLOT(cancelGlobalSearch()));
 
     d.nextShortcut = new QShortcut(QKeySequence::FindNext, page);
     d.prevShortcut = new QShortcut(QKeySequence::FindPrevious, page);
@@ -72,6 +80,7 @@ void Finder::searchTree()
 {
     cancelListSearch();
     cancelBrowserSearch();
+    cancelGlobalSearch();
     d.lastSearch = TreeSearch;
     AbstractFinder* finder = d.page->treeWidget()->findChild<TreeFinder*>();
     if (!finder)
@@ -87,6 +96,7 @@ void Finder::searchList(BufferView* view)
     if (view && view->listView()->isVisible()) {
         cancelTreeSearch();
         cancelBrowserSearch();
+        cancelGlobalSearch();
         d.lastSearch = ListSearch;
         AbstractFinder* finder = view->listView()->findChild<ListFinder*>();
         if (!finder)
@@ -103,15 +113,33 @@ void Finder::searchBrowser(BufferView* view)
     if (view && view->isVisible()) {
         cancelListSearch();
         cancelTreeSearch();
+        cancelGlobalSearch();
         d.lastSearch = BrowserSearch;
-        AbstractFinder* finder = view->textBrowser()->findChild<BrowserFinder*>();
-        if (!finder)
-            startSearch(new BrowserFinder(view->textBrowser()), d.browserSearch, d.browserFilter);
-        else if (!finder->isAncestorOf(qApp->focusWidget()))
+        AbstractFinder* finder = browserFinder(view);
+        if (!finder) {
+            if (view->viewMode() == BufferView::ListMode)
+                finder = new MessageFinder(view->messageView());
+            else
+                finder = new BrowserFinder(view->textBrowser());
+            startSearch(finder, d.browserSearch, d.browserMode);
+        } else if (!finder->isAncestorOf(qApp->focusWidget()))
             finder->reFind();
     }
 }
 
+void Finder::searchGlobal()
+{
+    cancelTreeSearch();
+    cancelListSearch();
+    cancelBrowserSearch();
+    d.lastSearch = GlobalSearch;
+    AbstractFinder* finder = d.page->splitView()->findChild<GlobalFinder*>();
+    if (!finder)
+        startSearch(new GlobalFinder(d.page), d.globalSearch);
+    else if (!finder->isAncestorOf(qApp->focusWidget()))
+        finder->reFind();
+}
+
 void Finder::findAgain()
 {
     switch (d.lastSearch) {
@@ -124,6 +152,9 @@ void Finder::findAgain()
     case BrowserSearch:
         searchBrowser();
         break;
+    case GlobalSearch:
+        searchGlobal();
+        break;
     case NoSearch:
     default:
         break;
@@ -146,7 +177,7 @@ void Finder::findPrevious()
         d.currentFinder->findPrevious();
 }
 
-void Finder::startSearch(AbstractFinder* finder, const QString& text, bool filter)
+void Finder::startSearch(AbstractFinder* finder, const QString& text, AbstractFinder::Mode mode)
 {
     connect(finder, SIGNAL(destroyed(AbstractFinder*)), this, SLOT(finderDestroyed(AbstractFinder*)));
     d.cancelShortcut->setEnabled(true);
@@ -154,7 +185,7 @@ void Finder::startSearch(AbstractFinder* finder, const QString& text, bool filte
     d.currentFinder = finder;
 
     finder->setText(text);
-    finder->setFilter(filter);
+    finder->setMode(mode);
     finder->doFind();
 }
 
@@ -192,19 +223,40 @@ void Finder::cancelBrowserSearch(BufferView* view)
     if (!view)
         view = d.page->currentView();
     if (view) {
-        AbstractFinder* finder = view->textBrowser()->findChild<BrowserFinder*>();
+        AbstractFinder* finder = browserFinder(view);
         if (finder) {
             d.browserSearch = finder->text();
-            d.browserFilter = finder->isFilter();
+            d.browserMode = finder->mode();
             finder->animateHide();
         }
-        view->textBrowser()->moveCursorToBottom();
-        view->textBrowser()->scrollToBottom();
+        if (view->viewMode() == BufferView::ListMode) {
+            view->messageView()->scrollToBottom();
+        } else {
+            view->textBrowser()->moveCursorToBottom();
+            view->textBrowser()->scrollToBottom();
+        }
         if (restoreFocus)
             view->textInput()->setFocus();
     }
 }
 
+void Finder::cancelGlobalSearch()
+{
+    AbstractFinder* finder = d.page->splitView()->findChild<GlobalFinder*>();
+    if (finder) {
+        d.globalSearch = finder->text();
+        finder->animateHide();
+    }
+}
+
+// the finder of whichever view shows the messages in the current mode
+AbstractFinder* Finder::browserFinder(BufferView* view) const
+{
+    if (view->viewMode() == BufferView::ListMode)
+        return view->messageView()->findChild<MessageFinder*>();
+    return view->textBrowser()->findChild<BrowserFinder*>();
+}
+
 void Finder::finderDestroyed(AbstractFinder* input)
 {
     d.finders.remove(input);
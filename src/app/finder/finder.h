@@ -33,10 +33,10 @@
 #include <QObject>
 #include <QPointer>
 #include <QShortcut>
+#include "abstractfinder.h"
 
 class ChatPage;
 class BufferView;
-class AbstractFinder;
 
 class Finder : public QObject
 {
@@ -55,22 +55,28 @@ public slots:
     void searchBrowser(BufferView* view = 0);
     void cancelBrowserSearch(BufferView* view = 0);
 
+    void searchGlobal();
+    void cancelGlobalSearch();
+
 private slots:
     void findAgain();
     void findNext();
     void findPrevious();
-    void startSearch(AbstractFinder* input, const QString& text, bool filter = false);
+    void startSearch(AbstractFinder* input, const QString& text, AbstractFinder::Mode mode = AbstractFinder::Search);
     void finderDestroyed(AbstractFinder* input);
 
 private:
-    enum SearchMode { NoSearch, TreeSearch, ListSearch, BrowserSearch };
+    AbstractFinder* browserFinder(BufferView* view) const;
+
+    enum SearchMode { NoSearch, TreeSearch, ListSearch, BrowserSearch, GlobalSearch };
 
     struct Private {
         ChatPage* page;
-        bool browserFilter;
+        AbstractFinder::Mode browserMode;
         QString treeSearch;
         QString listSearch;
         QString browserSearch;
+        QString globalSearch;
         QSet<AbstractFinder*> finders;
         QShortcut* nextShortcut;
         QShortcut* prevShortcut;
@@ -8,11 +8,15 @@ INCLUDEPATH += $$PWD
 HEADERS += $$PWD/abstractfinder.h
 HEADERS += $$PWD/browserfinder.h
 HEADERS += $$PWD/finder.h
+HEADERS += $$PWD/globalfinder.h
 HEADERS += $$PWD/listfinder.h
+HEADERS += $$PWD/messagefinder.h
 HEADERS += $$PWD/treefinder.h
 
 SOURCES += $$PWD/abstractfinder.cpp
 SOURCES += $$PWD/browserfinder.cpp
 SOURCES += $$PWD/finder.cpp
+SOURCES += $$PWD/globalfinder.cpp
 SOURCES += $$PWD/listfinder.cpp
+SOURCES += $$PWD/messagefinder.cpp
 SOURCES += $$PWD/treefinder.cpp
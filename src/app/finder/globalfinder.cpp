@@ -0,0 +1,170 @@
+/*
+  Copyright (C) 2008-2016 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "globalfinder.h"
+#include "textdocument.h"
+#include "messagemodel.h"
+#include "messageview.h"
+#include "textbrowser.h"
+#include "bufferview.h"
+#include "splitview.h"
+#include "chatpage.h"
+#include <QTextBlock>
+#include <QDateTime>
+#include <IrcBuffer>
+
+// hits listed above the finder, the rest is left to next/previous
+static const int MaximumHits = 200;
+static const int VisibleHits = 10;
+
+GlobalFinder::GlobalFinder(ChatPage* page) : AbstractFinder(page->splitView())
+{
+    d.page = page;
+
+    d.results = new QListWidget(page->splitView());
+    d.results->setObjectName("results");
+    d.results->setUniformItemSizes(true);
+    d.results->setFocusPolicy(Qt::NoFocus);
+    d.results->hide();
+
+    connect(d.results, SIGNAL(itemClicked(QListWidgetItem*)), this, SLOT(open()));
+    connect(d.results, SIGNAL(itemActivated(QListWidgetItem*)), this, SLOT(openAndHide()));
+    connect(this, SIGNAL(returnPressed()), this, SLOT(openAndHide()));
+}
+
+GlobalFinder::~GlobalFinder()
+{
+    delete d.results;
+}
+
+void GlobalFinder::setVisible(bool visible)
+{
+    AbstractFinder::setVisible(visible);
+    if (!visible)
+        d.results->hide();
+}
+
+void GlobalFinder::find(const QString& text, bool forward, bool backward, bool typed)
+{
+    if (typed) {
+        d.hits = SearchIndex::instance()->search(text, MaximumHits);
+        d.results->clear();
+        foreach (const SearchIndex::Hit& hit, d.hits) {
+            const QString time = QDateTime::fromMSecsSinceEpoch(hit.timestamp).toString(Qt::SystemLocaleShortDate);
+            d.results->addItem(tr("%1  %2  <%3> %4").arg(hit.buffer->title(), time, hit.nick, hit.text));
+        }
+        d.results->setVisible(!d.hits.isEmpty());
+        if (!d.hits.isEmpty())
+            d.results->setCurrentRow(0);
+        setError(!text.isEmpty() && d.hits.isEmpty());
+        relocate();
+    } else if (!d.hits.isEmpty()) {
+        const int count = d.hits.count();
+        int row = d.results->currentRow();
+        if (forward)
+            row = (row + 1) % count;
+        else if (backward)
+            row = (row + count - 1) % count;
+        d.results->setCurrentRow(row);
+        open();
+    }
+}
+
+void GlobalFinder::relocate()
+{
+    QRect r = rect();
+    QRect br = parentWidget()->rect();
+    r.setWidth(br.width() / 2);
+    r.moveBottomRight(br.bottomRight());
+    r.translate(1, -offset());
+    setGeometry(r);
+    raise();
+
+    if (d.results->isVisible()) {
+        const int rows = qMin(VisibleHits, d.results->count());
+        const int height = rows * qMax(1, d.results->sizeHintForRow(0)) + 2 * d.results->frameWidth();
+        d.results->setGeometry(r.x(), r.y() - height, r.width(), height);
+        d.results->raise();
+    }
+}
+
+// switches to the buffer and scrolls to the line in whichever view shows
+// it, as long as it is still in the window of the document
+void GlobalFinder::open()
+{
+    const int row = d.results->currentRow();
+    if (row < 0 || row >= d.hits.count())
+        return;
+
+    const SearchIndex::Hit hit = d.hits.at(row);
+    if (!hit.buffer)
+        return;
+
+    d.page->splitView()->setCurrentBuffer(hit.buffer);
+    BufferView* view = d.page->currentView();
+    TextDocument* doc = view ? view->textDocument() : 0;
+    if (!doc)
+        return;
+
+    bool found = false;
+    if (view->viewMode() == BufferView::ListMode) {
+        const int line = doc->messageModel()->rowAt(hit.id);
+        if (line != -1) {
+            view->messageView()->setCurrentRow(line);
+            found = true;
+        }
+    } else {
+        const int line = doc->lineAt(hit.id);
+        if (line != -1) {
+            const QTextBlock block = doc->findBlockByNumber(line);
+            QTextCursor cursor(block);
+            const QStringList terms = SearchIndex::tokenize(text(), false);
+            if (!terms.isEmpty()) {
+                const QTextCursor match = doc->find(terms.first(), cursor);
+                if (!match.isNull() && match.block() == block)
+                    cursor = match;
+            }
+            view->textBrowser()->setTextCursor(cursor);
+            view->textBrowser()->ensureCursorVisible();
+            found = true;
+        }
+    }
+
+    // the line has left the window of the document since it was indexed
+    if (!found) {
+        QListWidgetItem* item = d.results->item(row);
+        item->setFlags(item->flags() & ~Qt::ItemIsEnabled);
+        item->setToolTip(tr("No longer in the buffer history"));
+    }
+}
+
+void GlobalFinder::openAndHide()
+{
+    open();
+    animateHide();
+}
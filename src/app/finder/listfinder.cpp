@@ -30,9 +30,23 @@
 #include "listview.h"
 #include <Irc>
 
+// the best matches, ranked first and stepped through before the rest
+static const int Limit = 50;
+
 ListFinder::ListFinder(ListView* list) : AbstractFinder(list)
 {
+    d.dirty = true;
+    d.limit = Limit;
     d.list = list;
+    if (list && list->model()) {
+        // the index is keyed by name, so that the user list re-sorting
+        // itself does not matter, and joins and parts patch it in place
+        QAbstractItemModel* model = list->model();
+        connect(model, SIGNAL(rowsInserted(QModelIndex,int,int)), this, SLOT(onRowsInserted(QModelIndex,int,int)));
+        connect(model, SIGNAL(rowsAboutToBeRemoved(QModelIndex,int,int)), this, SLOT(onRowsAboutToBeRemoved(QModelIndex,int,int)));
+        connect(model, SIGNAL(dataChanged(QModelIndex,QModelIndex)), this, SLOT(onDataChanged(QModelIndex,QModelIndex)));
+        connect(model, SIGNAL(modelReset()), this, SLOT(invalidate()));
+    }
     connect(this, SIGNAL(returnPressed()), this, SLOT(onReturnPressed()));
 }
 
@@ -42,40 +56,28 @@ void ListFinder::find(const QString& text, bool forward, bool backward, bool typ
     if (!d.list || !d.list->model() || text.isEmpty())
         return;
 
-    QAbstractItemModel* model = d.list->model();
+    if (typed || d.text != text)
+        search(text, Limit);
+
+    const QString current = d.list->currentIndex().data(Irc::NameRole).toString();
     if (typed) {
-        QList<QModelIndex> indexes = model->match(model->index(0, 0), Irc::NameRole, text, -1, Qt::MatchExactly | Qt::MatchWrap);
-        if (indexes.isEmpty())
-            indexes = model->match(model->index(0, 0), Irc::NameRole, text, -1, Qt::MatchContains | Qt::MatchWrap);
-        if (!indexes.isEmpty() && !indexes.contains(d.list->currentIndex()))
-            d.list->setCurrentIndex(indexes.first());
-        setError(indexes.isEmpty());
-    } else {
-        QModelIndex index = d.list->currentIndex();
-        if (index.isValid()) {
-            if (forward)
-                index = index.sibling(index.row() + 1, index.column());
-            else
-                index = index.sibling(index.row() - 1, index.column());
-            bool wrapped = false;
-            while (index.isValid()) {
-                if (index.data(Irc::NameRole).toString().contains(text, Qt::CaseInsensitive)) {
-                    d.list->setCurrentIndex(index);
-                    return;
-                }
-                if (forward)
-                    index = index.sibling(index.row() + 1, index.column());
-                else
-                    index = index.sibling(index.row() - 1, index.column());
-                if (!index.isValid() && !wrapped) {
-                    if (forward)
-                        index = model->index(0, 0);
-                    else
-                        index = model->index(model->rowCount() - 1, 0);
-                    wrapped = true;
-                }
-            }
+        if (!d.matches.isEmpty() && !d.matches.contains(current))
+            d.list->setCurrentIndex(indexOf(d.matches.first()));
+        setError(d.matches.isEmpty());
+    } else if (!d.matches.isEmpty()) {
+        // step through the ranked matches, wrapping around at either end
+        // once the rest have been ranked too
+        int index = d.matches.indexOf(current);
+        const bool wrap = forward ? index + 1 >= d.matches.count() : index <= 0;
+        if (wrap && d.matches.count() >= d.limit) {
+            search(text, d.matcher.count());
+            index = d.matches.indexOf(current);
         }
+        if (forward)
+            index = index + 1 < d.matches.count() ? index + 1 : 0;
+        else
+            index = index > 0 ? index - 1 : d.matches.count() - 1;
+        d.list->setCurrentIndex(indexOf(d.matches.at(index)));
     }
 }
 
@@ -102,3 +104,75 @@ void ListFinder::onReturnPressed()
         animateHide();
     }
 }
+
+void ListFinder::invalidate()
+{
+    d.dirty = true;
+    d.text.clear();
+    d.matches.clear();
+}
+
+void ListFinder::onRowsInserted(const QModelIndex& parent, int first, int last)
+{
+    if (d.dirty || parent.isValid())
+        return;
+
+    QAbstractItemModel* model = d.list->model();
+    for (int row = first; row <= last; ++row)
+        d.matcher.addName(model->index(row, 0).data(Irc::NameRole).toString());
+    d.text.clear();
+}
+
+void ListFinder::onRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last)
+{
+    if (d.dirty || parent.isValid())
+        return;
+
+    QAbstractItemModel* model = d.list->model();
+    for (int row = first; row <= last; ++row)
+        d.matcher.removeName(model->index(row, 0).data(Irc::NameRole).toString());
+    d.text.clear();
+}
+
+// mode and activity changes keep the name; a nick change leaves the old
+// one behind, so only then is the index rebuilt
+void ListFinder::onDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight)
+{
+    if (d.dirty)
+        return;
+
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+        if (!d.matcher.contains(topLeft.sibling(row, 0).data(Irc::NameRole).toString())) {
+            invalidate();
+            return;
+        }
+    }
+}
+
+QModelIndex ListFinder::indexOf(const QString& name) const
+{
+    QAbstractItemModel* model = d.list->model();
+    const QModelIndexList indexes = model->match(model->index(0, 0), Irc::NameRole, name, 1, Qt::MatchExactly | Qt::MatchCaseSensitive);
+    return indexes.value(0);
+}
+
+// the names are read from the model once and then kept up to date, and
+// the matches are ranked names
+void ListFinder::search(const QString& text, int limit)
+{
+    QAbstractItemModel* model = d.list->model();
+    if (d.dirty) {
+        QStringList names;
+        const int count = model->rowCount();
+        for (int row = 0; row < count; ++row)
+            names += model->index(row, 0).data(Irc::NameRole).toString();
+        d.matcher.setNames(names);
+        d.dirty = false;
+    }
+
+    d.text = text;
+    d.limit = limit;
+    d.matches.clear();
+    foreach (const FuzzyMatcher::Match& match, d.matcher.match(text, limit))
+        d.matches += d.matcher.name(match.index);
+}
@@ -30,6 +30,8 @@
 #define LISTFINDER_H
 
 #include "abstractfinder.h"
+#include "fuzzymatcher.h"
+#include <QModelIndex>
 
 class ListView;
 
@@ -46,10 +48,22 @@ protected slots:
 
 private slots:
     void onReturnPressed();
+    void invalidate();
+    void onRowsInserted(const QModelIndex& parent, int first, int last);
+    void onRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last);
+    void onDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
 
 private:
+    QModelIndex indexOf(const QString& name) const;
+    void search(const QString& text, int limit);
+
     struct Private {
+        bool dirty;
+        int limit;
         ListView* list;
+        QString text;
+        FuzzyMatcher matcher;
+        QStringList matches;
     } d;
 };
 
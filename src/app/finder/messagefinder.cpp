@@ -0,0 +1,225 @@
+/*
+  Copyright (C) 2008-2016 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "messagefinder.h"
+#include "messageview.h"
+#include "messagemodel.h"
+#include "textdocument.h"
+#include <QTimerEvent>
+#include <algorithm>
+
+// typing is folded into a single search after a short pause
+static const int Delay = 150;
+
+MessageFinder::MessageFinder(MessageView* view) : AbstractFinder(view)
+{
+    d.view = view;
+    d.end = 0;
+    connect(view, SIGNAL(documentChanged(TextDocument*)), this, SLOT(deleteLater()));
+    connect(this, SIGNAL(returnPressed()), this, SLOT(findNext()));
+
+    addModeMenu();
+}
+
+MessageFinder::~MessageFinder()
+{
+}
+
+void MessageFinder::setVisible(bool visible)
+{
+    AbstractFinder::setVisible(visible);
+    if (!visible) {
+        d.timer.stop();
+        d.view->setCurrentRow(-1);
+        d.view->setFilter(MessageQuery());
+    }
+}
+
+void MessageFinder::find(const QString& text, bool forward, bool backward, bool typed)
+{
+    if (typed) {
+        if (!isVisible())
+            animateShow();
+        d.timer.start(Delay, this);
+        return;
+    }
+
+    // stepping right after typing does not wait for the pause
+    if (d.timer.isActive()) {
+        d.timer.stop();
+        search(text, false, false, true);
+    }
+    search(text, forward, backward, false);
+}
+
+void MessageFinder::filter(const QString& text)
+{
+    applyFilter(MessageQuery(text, MessageQuery::PlainText));
+}
+
+// queries are parsed and run after the same pause as searches, except
+// for clearing one which takes effect right away
+void MessageFinder::query(const QString& text)
+{
+    if (text.isEmpty()) {
+        d.timer.stop();
+        applyFilter(MessageQuery());
+    } else {
+        if (!isVisible())
+            animateShow();
+        d.timer.start(Delay, this);
+    }
+}
+
+void MessageFinder::timerEvent(QTimerEvent* event)
+{
+    if (event->timerId() == d.timer.timerId()) {
+        d.timer.stop();
+        if (mode() == Query)
+            applyFilter(MessageQuery(text()));
+        else
+            search(text(), false, false, true);
+    } else {
+        AbstractFinder::timerEvent(event);
+    }
+}
+
+MessageModel* MessageFinder::model() const
+{
+    TextDocument* doc = d.view->document();
+    return doc ? doc->messageModel() : 0;
+}
+
+// steps through the matching rows, wrapping around at either end; while
+// typing, the current row is kept for as long as it still matches
+void MessageFinder::search(const QString& text, bool forward, bool backward, bool typed)
+{
+    Q_UNUSED(backward);
+    MessageModel* model = this->model();
+    if (!model)
+        return;
+
+    collect(text);
+
+    int row = -1;
+    if (!d.matches.isEmpty()) {
+        // matches are keyed by offset + row, which trimming does not shift
+        const int offset = model->offset();
+        const int current = d.view->currentRow() == -1 ? -1 : offset + d.view->currentRow();
+        QVector<int>::const_iterator it;
+        if (forward) {
+            it = std::upper_bound(d.matches.constBegin(), d.matches.constEnd(), current);
+            if (it == d.matches.constEnd())
+                it = d.matches.constBegin();
+        } else {
+            int from = current;
+            if (current == -1)
+                from = offset + model->count();
+            else if (typed)
+                from = current + 1;
+            it = std::lower_bound(d.matches.constBegin(), d.matches.constEnd(), from);
+            if (it == d.matches.constBegin())
+                it = d.matches.constEnd();
+            --it;
+        }
+        row = *it - offset;
+    }
+
+    if (!isVisible())
+        animateShow();
+    d.view->setCurrentRow(row);
+    setError(!text.isEmpty() && d.matches.isEmpty());
+}
+
+// the matching rows are collected once per text and only narrowed down
+// as it grows; rows appended or trimmed meanwhile just adjust the ends
+void MessageFinder::collect(const QString& text)
+{
+    MessageModel* model = this->model();
+    const MessageQuery query(text, MessageQuery::PlainText);
+    const int offset = model->offset();
+    const int first = offset + d.view->firstRow();
+    const int end = offset + model->count();
+
+    int from = first;
+    if (query.isEmpty()) {
+        d.matches.clear();
+        from = end;
+    } else if (query == d.query || query.refines(d.query)) {
+        // the last row may have been replaced by a merged one since
+        from = qBound(first, d.end - 1, end);
+        d.matches.erase(d.matches.begin(), std::lower_bound(d.matches.begin(), d.matches.end(), first));
+        d.matches.erase(std::lower_bound(d.matches.begin(), d.matches.end(), from), d.matches.end());
+        if (query != d.query) {
+            QVector<int> matches;
+            foreach (int key, d.matches) {
+                if (query.matches(model->message(key - offset)))
+                    matches += key;
+            }
+            d.matches = matches;
+        }
+    } else {
+        d.matches.clear();
+    }
+
+    for (int key = from; key < end; ++key) {
+        if (query.matches(model->message(key - offset)))
+            d.matches += key;
+    }
+    d.query = query;
+    d.end = end;
+}
+
+// the filter is kept by the view, so that other splits of the same
+// buffer are not affected
+void MessageFinder::applyFilter(const MessageQuery& filter)
+{
+    d.view->setCurrentRow(-1);
+    d.view->setFilter(filter);
+
+    MessageModel* model = this->model();
+    bool found = filter.isEmpty();
+    const int count = model && !found ? model->count() : 0;
+    for (int row = d.view->firstRow(); !found && row < count; ++row)
+        found = !d.view->isFiltered(row);
+
+    if (!isVisible())
+        animateShow();
+    lineEdit()->setToolTip(filter.errorString());
+    setError(!filter.isValid() || !found);
+}
+
+void MessageFinder::relocate()
+{
+    QRect r = rect();
+    QRect br = parentWidget()->rect();
+    r.setWidth(br.width() / 3);
+    r.moveBottomRight(br.bottomRight());
+    r.translate(1, -offset());
+    setGeometry(r);
+    raise();
+}
@@ -0,0 +1,73 @@
+/*
+  Copyright (C) 2008-2016 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef MESSAGEFINDER_H
+#define MESSAGEFINDER_H
+
+#include "abstractfinder.h"
+#include "messagequery.h"
+#include <QBasicTimer>
+#include <QVector>
+
+class MessageView;
+class MessageModel;
+
+class MessageFinder : public AbstractFinder
+{
+    Q_OBJECT
+
+public:
+    explicit MessageFinder(MessageView* view);
+    ~MessageFinder();
+
+    void setVisible(bool visible);
+
+protected:
+    void timerEvent(QTimerEvent* event);
+
+protected slots:
+    void find(const QString& text, bool forward = false, bool backward = false, bool typed = true);
+    void filter(const QString& text);
+    void query(const QString& text);
+    void relocate();
+
+private:
+    MessageModel* model() const;
+    void search(const QString& text, bool forward, bool backward, bool typed);
+    void collect(const QString& text);
+    void applyFilter(const MessageQuery& filter);
+
+    struct Private {
+        MessageView* view;
+        QBasicTimer timer;
+        MessageQuery query;
+        int end;
+        QVector<int> matches;
+    } d;
+};
+
+#endif // MESSAGEFINDER_H
@@ -29,11 +29,25 @@
 #include "treefinder.h"
 #include "treewidget.h"
 
+// the best matches, ranked first and stepped through before the rest
+static const int Limit = 50;
+
 TreeFinder::TreeFinder(TreeWidget* tree) : AbstractFinder(tree)
 {
+    d.dirty = true;
+    d.limit = Limit;
     d.tree = tree;
-    if (tree)
+    if (tree) {
         tree->blockItemReset(true);
+
+        // the matches are items, so that the tree re-sorting itself does
+        // not matter, and the index is rebuilt only when items come or go
+        QAbstractItemModel* model = tree->model();
+        connect(model, SIGNAL(rowsInserted(QModelIndex,int,int)), this, SLOT(invalidate()));
+        connect(model, SIGNAL(rowsAboutToBeRemoved(QModelIndex,int,int)), this, SLOT(invalidate()));
+        connect(model, SIGNAL(dataChanged(QModelIndex,QModelIndex)), this, SLOT(onDataChanged(QModelIndex,QModelIndex)));
+        connect(model, SIGNAL(modelReset()), this, SLOT(invalidate()));
+    }
     connect(this, SIGNAL(returnPressed()), this, SLOT(animateHide()));
 }
 
@@ -50,40 +64,27 @@ void TreeFinder::find(const QString& text, bool forward, bool backward, bool typ
     if (!d.tree || text.isEmpty())
         return;
 
+    if (typed || d.text != text)
+        search(text, Limit);
+
     if (typed) {
-        QList<QTreeWidgetItem*> items = d.tree->findItems(text, Qt::MatchExactly | Qt::MatchWrap | Qt::MatchRecursive);
-        if (items.isEmpty())
-            items = d.tree->findItems(text, Qt::MatchContains | Qt::MatchWrap | Qt::MatchRecursive);
-        if (!items.isEmpty() && !items.contains(d.tree->currentItem()))
-            d.tree->setCurrentItem(items.first());
-        setError(items.isEmpty());
-    } else {
-        QTreeWidgetItem* item = d.tree->currentItem();
-        if (item) {
-            QTreeWidgetItemIterator it(item);
-            if (forward)
-                ++it;
-            else
-                --it;
-            bool wrapped = false;
-            while (*it) {
-                if ((*it)->text(0).contains(text, Qt::CaseInsensitive)) {
-                    d.tree->setCurrentItem(*it);
-                    return;
-                }
-                if (forward)
-                    ++it;
-                else
-                    --it;
-                if (!(*it) && !wrapped) {
-                    if (forward)
-                        it = QTreeWidgetItemIterator(d.tree);
-                    else
-                        it = QTreeWidgetItemIterator(lastItem());
-                    wrapped = true;
-                }
-            }
+        if (!d.matches.isEmpty() && !d.matches.contains(d.tree->currentItem()))
+            d.tree->setCurrentItem(d.matches.first());
+        setError(d.matches.isEmpty());
+    } else if (!d.matches.isEmpty()) {
+        // step through the ranked matches, wrapping around at either end
+        // once the rest have been ranked too
+        int index = d.matches.indexOf(d.tree->currentItem());
+        const bool wrap = forward ? index + 1 >= d.matches.count() : index <= 0;
+        if (wrap && d.matches.count() >= d.limit) {
+            search(text, d.matcher.count());
+            index = d.matches.indexOf(d.tree->currentItem());
         }
+        if (forward)
+            index = index + 1 < d.matches.count() ? index + 1 : 0;
+        else
+            index = index > 0 ? index - 1 : d.matches.count() - 1;
+        d.tree->setCurrentItem(d.matches.at(index));
     }
 }
 
@@ -98,10 +99,44 @@ void TreeFinder::relocate()
     raise();
 }
 
-QTreeWidgetItem* TreeFinder::lastItem() const
+void TreeFinder::invalidate()
 {
-    QTreeWidgetItem* item = d.tree->topLevelItem(d.tree->topLevelItemCount() - 1);
-    if (item && item->childCount() > 0)
-        item = item->child(item->childCount() - 1);
-    return item;
+    d.dirty = true;
+    d.text.clear();
+    d.matches.clear();
+}
+
+// activity and badge changes keep the text; a renamed item leaves the old
+// name behind, so only then is the index rebuilt
+void TreeFinder::onDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight)
+{
+    if (d.dirty)
+        return;
+
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+        if (!d.matcher.contains(topLeft.sibling(row, 0).data(Qt::DisplayRole).toString())) {
+            invalidate();
+            return;
+        }
+    }
+}
+
+void TreeFinder::search(const QString& text, int limit)
+{
+    if (d.dirty) {
+        QStringList names;
+        d.items.clear();
+        for (QTreeWidgetItemIterator it(d.tree); *it; ++it) {
+            d.items += *it;
+            names += (*it)->text(0);
+        }
+        d.matcher.setNames(names);
+        d.dirty = false;
+    }
+
+    d.text = text;
+    d.limit = limit;
+    d.matches.clear();
+    foreach (const FuzzyMatcher::Match& match, d.matcher.match(text, limit))
+        d.matches += d.items.at(match.index);
 }
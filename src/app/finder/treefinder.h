@@ -30,6 +30,7 @@
 #define TREEFINDER_H
 
 #include "abstractfinder.h"
+#include "fuzzymatcher.h"
 #include <QTreeWidgetItem>
 
 class TreeWidget;
@@ -47,11 +48,21 @@ protected slots:
     void find(const QString& text, bool forward = false, bool backward = false, bool typed = true);
     void relocate();
 
+private slots:
+    void invalidate();
+    void onDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
+
 private:
-    QTreeWidgetItem* lastItem() const;
+    void search(const QString& text, int limit);
 
     struct Private {
+        bool dirty;
+        int limit;
         TreeWidget* tree;
+        QString text;
+        FuzzyMatcher matcher;
+        QList<QTreeWidgetItem*> items;
+        QList<QTreeWidgetItem*> matches;
     } d;
 };
 
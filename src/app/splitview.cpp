@@ -31,6 +31,7 @@
 #include "titlebar.h"
 #include "bufferview.h"
 #include "textbrowser.h"
+#include "messageview.h"
 #include <QContextMenuEvent>
 #include <IrcConnection>
 #include <QApplication>
@@ -209,6 +210,7 @@ BufferView* SplitView::createBufferView(QSplitter* splitter, int index)
     BufferView* view = new BufferView(splitter);
     connect(view, SIGNAL(destroyed(BufferView*)), this, SLOT(onViewRemoved(BufferView*)));
     connect(view->textBrowser(), SIGNAL(customContextMenuRequested(QPoint)), this, SLOT(showContextMenu(QPoint)));
+    connect(view->messageView(), SIGNAL(customContextMenuRequested(QPoint)), this, SLOT(showContextMenu(QPoint)));
 
     // TODO: because of theme preview
     if (window()->inherits("QMainWindow")) {
@@ -304,8 +306,8 @@ QVariantMap SplitView::saveSplittedViews(const QSplitter* splitter) const
             buf.insert("uuid", connection ? connection->userData().value("uuid").toString() : QString());
             if (QSplitter* sp = bv->findChild<QSplitter*>())
                 buf.insert("state", sp->saveState());
-            buf.insert("fontSize", bv->textBrowser()->font().pointSize());
-            buf.insert("fontFamily", bv->textBrowser()->font().family());
+            buf.insert("fontSize", bv->textFont().pointSize());
+            buf.insert("fontFamily", bv->textFont().family());
             buffers += buf;
         }
     }
@@ -355,7 +357,7 @@ void SplitView::restoreSplittedViews(QSplitter* splitter, const QVariantMap& sta
             int sz = buf.value("fontSize", -1).toInt();
             if (sz > 0)
                 f.setPointSize(sz);
-            bv->textBrowser()->setFont(f);
+            bv->setTextFont(f);
             if (buf.value("current", false).toBool())
                 setCurrentView(bv);
             bv->setObjectName("__unrestored__");
@@ -405,21 +407,21 @@ void SplitView::zoomIn()
 {
     BufferView* view = targetView();
     if (view)
-        view->textBrowser()->zoomIn();
+        view->zoomIn();
 }
 
 void SplitView::zoomOut()
 {
     BufferView* view = targetView();
     if (view)
-        view->textBrowser()->zoomOut();
+        view->zoomOut();
 }
 
 void SplitView::resetZoom()
 {
     BufferView* view = targetView();
     if (view)
-        view->textBrowser()->resetZoom();
+        view->resetZoom();
 }
 
 void SplitView::closeView()
@@ -500,7 +502,7 @@ void SplitView::addZoomActions(QMenu* menu, BufferView* view)
     zoomOutAction->setData(QVariant::fromValue(view));
 
     QAction* resetZoomAction = menu->addAction(tr("Reset zoom"), this, SLOT(resetZoom()), QKeySequence(tr("Ctrl+0")));
-    resetZoomAction->setEnabled(view->textBrowser()->isZoomed());
+    resetZoomAction->setEnabled(view->isZoomed());
     resetZoomAction->setShortcutContext(Qt::WidgetShortcut);
     resetZoomAction->setData(QVariant::fromValue(view));
 }
@@ -524,24 +526,35 @@ void SplitView::addGlobalActions(QMenu* menu)
 
 void SplitView::showContextMenu(const QPoint& pos)
 {
-    TextBrowser* browser = qobject_cast<TextBrowser*>(sender());
-    if (browser) {
-        // select nick/channel under to enable "Copy"
-        const QString anchor = browser->anchorAt(pos);
-        if (anchor.startsWith("nick:") || anchor.startsWith("channel:")) {
-            QTextCursor cursor = browser->cursorForPosition(pos);
-            cursor.select(QTextCursor::WordUnderCursor);
-            browser->setTextCursor(cursor);
+    QAbstractScrollArea* area = qobject_cast<QAbstractScrollArea*>(sender());
+    TextBrowser* browser = qobject_cast<TextBrowser*>(area);
+    MessageView* messageView = qobject_cast<MessageView*>(area);
+    if (browser || messageView) {
+        QString anchor;
+        QMenu* menu = 0;
+        IrcBuffer* buffer = 0;
+        if (browser) {
+            // select nick/channel under to enable "Copy"
+            anchor = browser->anchorAt(pos);
+            if (anchor.startsWith("nick:") || anchor.startsWith("channel:")) {
+                QTextCursor cursor = browser->cursorForPosition(pos);
+                cursor.select(QTextCursor::WordUnderCursor);
+                browser->setTextCursor(cursor);
+            }
+            menu = browser->createContextMenu(pos);
+            buffer = browser->buffer();
+        } else {
+            anchor = messageView->anchorAt(pos);
+            menu = messageView->createContextMenu(pos);
+            buffer = messageView->buffer();
         }
 
-        QMenu* menu = browser->createContextMenu(pos);
-
         QAction* restoreUsers = 0;
         QAction* restoreViews = 0;
 
-        QSplitter* splitter = qobject_cast<QSplitter*>(browser->parentWidget());
+        QSplitter* splitter = qobject_cast<QSplitter*>(area->parentWidget());
+        BufferView* view = splitter ? qobject_cast<BufferView*>(splitter->parentWidget()) : 0;
         if (splitter && anchor.isEmpty()) {
-            BufferView* view = qobject_cast<BufferView*>(splitter->parentWidget());
             if (view) {
                 menu->addSeparator();
                 addZoomActions(menu, view);
@@ -551,9 +564,8 @@ void SplitView::showContextMenu(const QPoint& pos)
 
             QAction* separator = 0;
 
-            IrcBuffer* buffer = browser->buffer();
-            if (buffer && buffer->isChannel()) {
-                if (splitter && splitter->sizes().value(1) == 0) {
+            if (view && buffer && buffer->isChannel()) {
+                if (splitter->sizes().value(splitter->indexOf(view->listView())) == 0) {
                     separator = menu->addSeparator();
                     restoreUsers = menu->addAction(tr("Restore users"));
                 }
@@ -567,20 +579,25 @@ void SplitView::showContextMenu(const QPoint& pos)
             }
         }
 
-        QAction* action = menu->exec(browser->viewport()->mapToGlobal(pos));
+        QAction* action = menu->exec(area->viewport()->mapToGlobal(pos));
 
         QSplitter* restoreSplitter = 0;
         if (restoreUsers && action == restoreUsers)
-            restoreSplitter = qobject_cast<QSplitter*>(browser->parentWidget());
+            restoreSplitter = splitter;
         else if (restoreViews && action == restoreViews)
             restoreSplitter = window()->findChild<QSplitter*>();
-        if (restoreSplitter)
-            restoreSplitter->setSizes(QList<int>() << restoreSplitter->widget(0)->sizeHint().width() << restoreSplitter->widget(1)->sizeHint().width());
+        if (restoreSplitter) {
+            // the buffer view splitter holds a hidden view for the other mode
+            QList<int> sizes;
+            for (int i = 0; i < restoreSplitter->count(); ++i)
+                sizes += restoreSplitter->widget(i)->sizeHint().width();
+            restoreSplitter->setSizes(sizes);
+        }
 
         menu->deleteLater();
 
         // clear automatically done nick selection
-        if (anchor.startsWith("nick:")) {
+        if (browser && anchor.startsWith("nick:")) {
             QTextCursor cursor = browser->textCursor();
             cursor.clearSelection();
             browser->setTextCursor(cursor);
@@ -25,24 +25,54 @@ DEFINES += BUILD_BASE
 
 HEADERS += $$PWD/bufferview.h
 HEADERS += $$PWD/eventformatter.h
+HEADERS += $$PWD/flushscheduler.h
+HEADERS += $$PWD/formatcache.h
+HEADERS += $$PWD/formatpool.h
+HEADERS += $$PWD/formattemplate.h
+HEADERS += $$PWD/fuzzymatcher.h
 HEADERS += $$PWD/listview.h
 HEADERS += $$PWD/messagedata.h
 HEADERS += $$PWD/messageformatter.h
+HEADERS += $$PWD/messagemodel.h
+HEADERS += $$PWD/messagequery.h
+HEADERS += $$PWD/messageview.h
+HEADERS += $$PWD/nickindex.h
+HEADERS += $$PWD/nickmatcher.h
+HEADERS += $$PWD/richtextwriter.h
+HEADERS += $$PWD/scrollbackstore.h
+HEADERS += $$PWD/searchindex.h
 HEADERS += $$PWD/textbrowser.h
 HEADERS += $$PWD/textdocument.h
+HEADERS += $$PWD/textframe.h
 HEADERS += $$PWD/textinput.h
 HEADERS += $$PWD/themeinfo.h
+HEADERS += $$PWD/timestamprenderer.h
 HEADERS += $$PWD/titlebar.h
 
 SOURCES += $$PWD/bufferview.cpp
 SOURCES += $$PWD/eventformatter.cpp
+SOURCES += $$PWD/flushscheduler.cpp
+SOURCES += $$PWD/formatcache.cpp
+SOURCES += $$PWD/formatpool.cpp
+SOURCES += $$PWD/formattemplate.cpp
+SOURCES += $$PWD/fuzzymatcher.cpp
 SOURCES += $$PWD/listview.cpp
 SOURCES += $$PWD/messagedata.cpp
 SOURCES += $$PWD/messageformatter.cpp
+SOURCES += $$PWD/messagemodel.cpp
+SOURCES += $$PWD/messagequery.cpp
+SOURCES += $$PWD/messageview.cpp
+SOURCES += $$PWD/nickindex.cpp
+SOURCES += $$PWD/nickmatcher.cpp
+SOURCES += $$PWD/richtextwriter.cpp
+SOURCES += $$PWD/scrollbackstore.cpp
+SOURCES += $$PWD/searchindex.cpp
 SOURCES += $$PWD/textbrowser.cpp
 SOURCES += $$PWD/textdocument.cpp
+SOURCES += $$PWD/textframe.cpp
 SOURCES += $$PWD/textinput.cpp
 SOURCES += $$PWD/themeinfo.cpp
+SOURCES += $$PWD/timestamprenderer.cpp
 SOURCES += $$PWD/titlebar.cpp
 
 include(shared/shared.pri)
@@ -29,6 +29,7 @@
 #include "bufferview.h"
 #include "textdocument.h"
 #include "textbrowser.h"
+#include "messageview.h"
 #include "textinput.h"
 #include "listview.h"
 #include "titlebar.h"
@@ -42,6 +43,7 @@
 BufferView::BufferView(QWidget* parent) : QWidget(parent)
 {
     d.buffer = 0;
+    d.mode = TextMode;
 
     d.titleBar = new TitleBar(this);
     d.listView = new ListView(this);
@@ -53,32 +55,39 @@ BufferView::BufferView(QWidget* parent) : QWidget(parent)
     d.textBrowser->setFocusPolicy(Qt::ClickFocus);
     d.textBrowser->viewport()->setAttribute(Qt::WA_AcceptTouchEvents, false);
 
+    d.messageView = new MessageView(this);
+    d.messageView->setBuddy(d.textInput);
+    d.messageView->setFocusPolicy(Qt::ClickFocus);
+    d.messageView->setVisible(false);
+
     d.splitter = new QSplitter(this);
     d.splitter->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Expanding);
 
     QShortcut* zoomIn = new QShortcut(QKeySequence::ZoomIn, this);
     zoomIn->setContext(Qt::WidgetWithChildrenShortcut);
-    connect(zoomIn, SIGNAL(activated()), d.textBrowser, SLOT(zoomIn()));
+    connect(zoomIn, SIGNAL(activated()), this, SLOT(zoomIn()));
 
     QShortcut* zoomOut = new QShortcut(QKeySequence::ZoomOut, this);
     zoomOut->setContext(Qt::WidgetWithChildrenShortcut);
-    connect(zoomOut, SIGNAL(activated()), d.textBrowser, SLOT(zoomOut()));
+    connect(zoomOut, SIGNAL(activated()), this, SLOT(zoomOut()));
 
     QShortcut* resetZoom = new QShortcut(QKeySequence("Ctrl+0"), this);
     resetZoom->setContext(Qt::WidgetWithChildrenShortcut);
-    connect(resetZoom, SIGNAL(activated()), d.textBrowser, SLOT(resetZoom()));
+    connect(resetZoom, SIGNAL(activated()), this, SLOT(resetZoom()));
 
     QShortcut* pageDown = new QShortcut(QKeySequence::MoveToNextPage, this);
     pageDown->setContext(Qt::WidgetWithChildrenShortcut);
     connect(pageDown, SIGNAL(activated()), d.textBrowser, SLOT(scrollToNextPage()));
+    connect(pageDown, SIGNAL(activated()), d.messageView, SLOT(scrollToNextPage()));
 
     QShortcut* pageUp = new QShortcut(QKeySequence::MoveToPreviousPage, this);
     pageUp->setContext(Qt::WidgetWithChildrenShortcut);
     connect(pageUp, SIGNAL(activated()), d.textBrowser, SLOT(scrollToPreviousPage()));
+    connect(pageUp, SIGNAL(activated()), d.messageView, SLOT(scrollToPreviousPage()));
 
     QShortcut* clearBuffer = new QShortcut(QKeySequence(tr("CTRL+K")), this);
     clearBuffer->setContext(Qt::WidgetWithChildrenShortcut);
-    connect(clearBuffer, SIGNAL(activated()), d.textBrowser, SLOT(clear()));
+    connect(clearBuffer, SIGNAL(activated()), this, SLOT(clear()));
 
     QVBoxLayout* layout = new QVBoxLayout(this);
     layout->setSpacing(0);
@@ -90,12 +99,16 @@ BufferView::BufferView(QWidget* parent) : QWidget(parent)
     d.titleBar->raise();
 
     d.splitter->addWidget(d.textBrowser);
+    d.splitter->addWidget(d.messageView);
     d.splitter->addWidget(d.listView);
     d.splitter->setStretchFactor(0, 1);
+    d.splitter->setStretchFactor(1, 1);
 
     connect(d.listView, SIGNAL(queried(QString)), this, SLOT(openBuffer(QString)));
     connect(d.textBrowser, SIGNAL(queried(QString)), this, SLOT(openBuffer(QString)));
     connect(d.textBrowser, SIGNAL(joined(QString)), this, SLOT(openBuffer(QString)));
+    connect(d.messageView, SIGNAL(queried(QString)), this, SLOT(openBuffer(QString)));
+    connect(d.messageView, SIGNAL(joined(QString)), this, SLOT(openBuffer(QString)));
 }
 
 bool BufferView::eventFilter(QObject *object, QEvent *event) {
@@ -141,11 +154,58 @@ TextBrowser* BufferView::textBrowser() const
     return d.textBrowser;
 }
 
+MessageView* BufferView::messageView() const
+{
+    return d.messageView;
+}
+
 TextDocument* BufferView::textDocument() const
 {
+    if (d.mode == ListMode)
+        return d.messageView->document();
     return d.textBrowser->document();
 }
 
+QFont BufferView::textFont() const
+{
+    if (d.mode == ListMode)
+        return d.messageView->font();
+    return d.textBrowser->font();
+}
+
+// both views share the font, so that switching the mode keeps the zoom
+void BufferView::setTextFont(const QFont& font)
+{
+    d.textBrowser->setFont(font);
+    d.messageView->setFont(font);
+}
+
+bool BufferView::isZoomed() const
+{
+    const QFont f = textFont();
+    if (f.pointSize() != -1)
+        return f.pointSize() != QFont().pointSize();
+    return f.pixelSize() != QFont().pixelSize();
+}
+
+BufferView::ViewMode BufferView::viewMode() const
+{
+    return d.mode;
+}
+
+void BufferView::setViewMode(ViewMode mode)
+{
+    if (d.mode != mode) {
+        TextDocument* doc = textDocument();
+        attachDocument(0);
+        d.mode = mode;
+        d.textBrowser->setVisible(mode == TextMode);
+        d.messageView->setVisible(mode == ListMode);
+        d.messageView->setFont(d.textBrowser->font());
+        attachDocument(doc);
+    }
+}
+
 void BufferView::setBuffer(IrcBuffer* buffer)
 {
     if (d.buffer != buffer) {
@@ -171,21 +231,72 @@ void BufferView::setBuffer(IrcBuffer* buffer)
                 doc = documents.first()->clone();
                 emit cloned(doc);
             }
-            d.textBrowser->setDocument(doc);
+            attachDocument(doc);
         } else {
-            d.textBrowser->setDocument(0);
+            attachDocument(0);
         }
 
         emit bufferChanged(buffer);
     }
 }
 
+void BufferView::attachDocument(TextDocument* document)
+{
+    if (d.mode == ListMode)
+        d.messageView->setDocument(document);
+    else
+        d.textBrowser->setDocument(document);
+}
+
 void BufferView::closeBuffer()
 {
     if (d.buffer)
         emit bufferClosed(d.buffer);
 }
 
+void BufferView::clear()
+{
+    if (d.mode == ListMode)
+        d.messageView->clear();
+    else
+        d.textBrowser->clear();
+}
+
+void BufferView::zoomIn()
+{
+    zoom(1);
+}
+
+void BufferView::zoomOut()
+{
+    zoom(-1);
+}
+
+void BufferView::resetZoom()
+{
+    QFont f = textFont();
+    f.setPointSize(QFont().pointSize());
+    setTextFont(f);
+}
+
+// see QTextEdit::zoomInF()
+void BufferView::zoom(int range)
+{
+    QFont f = textFont();
+    if (f.pointSizeF() != -1) {
+        const qreal size = f.pointSizeF() + range;
+        if (size <= 0)
+            return;
+        f.setPointSizeF(size);
+    } else {
+        const int size = f.pixelSize() + range;
+        if (size <= 0)
+            return;
+        f.setPixelSize(size);
+    }
+    setTextFont(f);
+}
+
 void BufferView::resizeEvent(QResizeEvent* event)
 {
     QWidget::resizeEvent(event);
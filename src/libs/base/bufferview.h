@@ -37,6 +37,7 @@ class ListView;
 class IrcBuffer;
 class TextInput;
 class TextBrowser;
+class MessageView;
 class TextDocument;
 
 class BASE_EXPORT BufferView : public QWidget
@@ -48,19 +49,34 @@ public:
     explicit BufferView(QWidget* parent = 0);
     ~BufferView();
 
+    enum ViewMode { TextMode, ListMode };
+
     IrcBuffer* buffer() const;
 
+    ViewMode viewMode() const;
+    void setViewMode(ViewMode mode);
+
     TitleBar* titleBar() const;
     ListView* listView() const;
     TextInput* textInput() const;
     TextBrowser* textBrowser() const;
+    MessageView* messageView() const;
     TextDocument* textDocument() const;
 
+    QFont textFont() const;
+    void setTextFont(const QFont& font);
+    bool isZoomed() const;
+
 public slots:
     void setBuffer(IrcBuffer* buffer);
     void openBuffer(const QString& title);
     void closeBuffer();
 
+    void clear();
+    void zoomIn();
+    void zoomOut();
+    void resetZoom();
+
 signals:
     void destroyed(BufferView* view);
     void bufferChanged(IrcBuffer* buffer);
@@ -72,12 +88,17 @@ protected:
     bool eventFilter(QObject *object, QEvent *event);
 
 private:
+    void attachDocument(TextDocument* document);
+    void zoom(int range);
+
     struct Private {
+        ViewMode mode;
         IrcBuffer* buffer;
         TitleBar* titleBar;
         ListView* listView;
         TextInput* textInput;
         TextBrowser* textBrowser;
+        MessageView* messageView;
         QSplitter* splitter;
     } d;
 };
@@ -27,6 +27,7 @@
 */
 
 #include "eventformatter.h"
+#include "formattemplate.h"
 
 EventFormatter::EventFormatter(QObject* parent) : MessageFormatter(parent)
 {
@@ -34,7 +35,8 @@ EventFormatter::EventFormatter(QObject* parent) : MessageFormatter(parent)
 
 QString EventFormatter::formatEvent(const QString& event) const
 {
-    return tr("<span class='event'>%1 %2</span>").arg(formatExpander("!"), event);
+    const FormatTemplate span = FormatTemplate::translated(staticMetaObject.className(), QT_TR_NOOP("<span class='event'>%1 %2</span>"));
+    return span.arg(formatExpander("!"), event);
 }
 
 QString EventFormatter::formatInviteMessage(IrcInviteMessage* msg)
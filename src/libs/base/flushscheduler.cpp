@@ -0,0 +1,163 @@
+/*
+  Copyright (C) 2008-2016 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "flushscheduler.h"
+#include "textdocument.h"
+#include <QTimerEvent>
+
+// one tick per frame, and the share of it that may be spent flushing
+static const int Interval = 16;
+static const int Budget = 5;
+
+// lines inserted at once before the budget is checked again
+static const int SliceSize = 25;
+
+FlushScheduler::FlushScheduler(QObject* parent) : QObject(parent)
+{
+    d.clock.start();
+}
+
+FlushScheduler* FlushScheduler::instance()
+{
+    static FlushScheduler scheduler;
+    return &scheduler;
+}
+
+void FlushScheduler::schedule(TextDocument* document)
+{
+    foreach (const Entry& entry, d.entries) {
+        if (entry.document == document)
+            return;
+    }
+
+    Entry entry;
+    entry.document = document;
+    entry.since = d.clock.elapsed();
+    d.entries += entry;
+
+    if (!d.timer.isActive())
+        d.timer.start(Interval, this);
+}
+
+void FlushScheduler::cancel(TextDocument* document)
+{
+    for (int i = 0; i < d.entries.count(); ++i) {
+        if (d.entries.at(i).document == document) {
+            d.entries.removeAt(i);
+            break;
+        }
+    }
+
+    if (d.entries.isEmpty())
+        d.timer.stop();
+}
+
+// read-only metrics of the backlog that has not reached the documents
+int FlushScheduler::pendingDocuments() const
+{
+    return d.entries.count();
+}
+
+int FlushScheduler::queueDepth() const
+{
+    int depth = 0;
+    foreach (const Entry& entry, d.entries) {
+        if (entry.document)
+            depth += entry.document->d.queue.count();
+    }
+    return depth;
+}
+
+qint64 FlushScheduler::oldestPendingAge() const
+{
+    if (d.entries.isEmpty())
+        return 0;
+
+    qint64 oldest = d.entries.first().since;
+    foreach (const Entry& entry, d.entries)
+        oldest = qMin(oldest, entry.since);
+    return d.clock.elapsed() - oldest;
+}
+
+void FlushScheduler::timerEvent(QTimerEvent* event)
+{
+    if (event->timerId() != d.timer.timerId()) {
+        QObject::timerEvent(event);
+        return;
+    }
+
+    QElapsedTimer budget;
+    budget.start();
+    while (budget.elapsed() < Budget) {
+        const int index = next();
+        if (index == -1)
+            break;
+
+        TextDocument* document = d.entries.at(index).document;
+        if (!document->drain(SliceSize))
+            cancel(document);
+    }
+
+    // documents destroyed while pending leave nothing to wait for
+    if (d.entries.isEmpty())
+        d.timer.stop();
+}
+
+// visible documents first, then the most recently viewed ones, and
+// the ones that have been waiting the longest after that
+int FlushScheduler::next()
+{
+    int best = -1;
+    for (int i = d.entries.count() - 1; i >= 0; --i) {
+        const Entry& entry = d.entries.at(i);
+        if (!entry.document) {
+            d.entries.removeAt(i);
+            if (best > i)
+                --best;
+            continue;
+        }
+
+        if (best == -1) {
+            best = i;
+            continue;
+        }
+
+        const Entry& other = d.entries.at(best);
+        const bool visible = entry.document->isVisible();
+        if (visible != other.document->isVisible()) {
+            if (visible)
+                best = i;
+        } else if (entry.document->d.viewed != other.document->d.viewed) {
+            if (entry.document->d.viewed > other.document->d.viewed)
+                best = i;
+        } else if (entry.since <= other.since) {
+            best = i;
+        }
+    }
+    return best;
+}
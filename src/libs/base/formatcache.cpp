@@ -0,0 +1,100 @@
+/*
+  Copyright (C) 2008-2016 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "formatcache.h"
+
+// formatted lines keyed by their raw bytes, so that clones, tooltips and
+// replays of the same line do not format it again, the cost of an entry
+// is its length and the least recently used entries go first
+
+FormatCache::FormatCache()
+{
+    d.version = 0;
+    d.hits = 0;
+    d.misses = 0;
+    d.formats.setMaxCost(2 * 1024 * 1024);
+}
+
+FormatCache* FormatCache::instance()
+{
+    static FormatCache cache;
+    return &cache;
+}
+
+int FormatCache::capacity() const
+{
+    return d.formats.maxCost();
+}
+
+void FormatCache::setCapacity(int capacity)
+{
+    d.formats.setMaxCost(capacity);
+}
+
+int FormatCache::version() const
+{
+    return d.version;
+}
+
+// entries of older versions are never hit again and age out
+void FormatCache::invalidate()
+{
+    ++d.version;
+}
+
+bool FormatCache::find(const QByteArray& key, QString* format)
+{
+    if (QString* cached = d.formats.object(key)) {
+        *format = *cached;
+        ++d.hits;
+        return true;
+    }
+    ++d.misses;
+    return false;
+}
+
+void FormatCache::insert(const QByteArray& key, const QString& format)
+{
+    d.formats.insert(key, new QString(format), qMax(1, format.length()));
+}
+
+int FormatCache::hits() const
+{
+    return d.hits;
+}
+
+int FormatCache::misses() const
+{
+    return d.misses;
+}
+
+qreal FormatCache::hitRate() const
+{
+    const int total = d.hits + d.misses;
+    return total ? qreal(d.hits) / total : 0.0;
+}
@@ -0,0 +1,132 @@
+/*
+  Copyright (C) 2008-2016 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "formatpool.h"
+#include "messageformatter.h"
+#include <IrcTextFormat>
+#include <QThreadStorage>
+#include <QRunnable>
+#include <QThread>
+
+// message text is rendered to html by a pool of workers, each with a
+// text format of its own and a snapshot of the channel's nicks
+
+enum State { Queued, Running, Done };
+
+static IrcTextFormat* textFormat()
+{
+    static QThreadStorage<IrcTextFormat*> formats;
+    if (!formats.hasLocalData()) {
+        IrcTextFormat* format = new IrcTextFormat;
+        format->setSpanFormat(IrcTextFormat::SpanClass);
+        formats.setLocalData(format);
+    }
+    return formats.localData();
+}
+
+class FormatRunnable : public QRunnable
+{
+public:
+    FormatRunnable(const QSharedPointer<FormatTask>& task) : task(task) { }
+
+    void run()
+    {
+        if (task->run())
+            emit FormatPool::instance()->finished();
+    }
+
+private:
+    QSharedPointer<FormatTask> task;
+};
+
+FormatTask::FormatTask(const QString& text, const NickMatcher& names)
+{
+    d.state.store(Queued);
+    d.text = text;
+    d.names = names;
+}
+
+QString FormatTask::text() const
+{
+    return d.text;
+}
+
+QString FormatTask::html() const
+{
+    return d.html;
+}
+
+bool FormatTask::isDone() const
+{
+    return d.state.loadAcquire() == Done;
+}
+
+// whoever gets to the task first renders it, the pool or the gui thread
+bool FormatTask::run()
+{
+    if (!d.state.testAndSetAcquire(Queued, Running))
+        return false;
+
+    d.html = MessageFormatter::renderText(d.text, textFormat(), d.names);
+    d.state.storeRelease(Done);
+    d.done.release();
+    return true;
+}
+
+// blocks instead of spinning while a worker is still rendering the task
+void FormatTask::wait()
+{
+    if (!run() && !isDone()) {
+        d.done.acquire();
+        d.done.release();
+    }
+}
+
+FormatPool::FormatPool(QObject* parent) : QObject(parent)
+{
+    // leave a core for the gui thread
+    d.pool.setMaxThreadCount(QThread::idealThreadCount() - 1);
+}
+
+FormatPool* FormatPool::instance()
+{
+    static FormatPool pool;
+    return &pool;
+}
+
+bool FormatPool::isActive() const
+{
+    return d.pool.maxThreadCount() > 0;
+}
+
+QSharedPointer<FormatTask> FormatPool::render(const QString& text, const NickMatcher& names)
+{
+    QSharedPointer<FormatTask> task(new FormatTask(text, names));
+    d.pool.start(new FormatRunnable(task));
+    return task;
+}
@@ -0,0 +1,85 @@
+/*
+  Copyright (C) 2008-2016 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef FORMATPOOL_H
+#define FORMATPOOL_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <QSharedPointer>
+#include "baseglobal.h"
+#include "nickmatcher.h"
+
+class BASE_EXPORT FormatTask
+{
+public:
+    FormatTask(const QString& text, const NickMatcher& names);
+
+    QString text() const;
+    QString html() const;
+
+    bool isDone() const;
+    bool run();
+    void wait();
+
+private:
+    Q_DISABLE_COPY(FormatTask)
+
+    struct Private {
+        QAtomicInt state;
+        QSemaphore done;
+        QString text;
+        QString html;
+        NickMatcher names;
+    } d;
+};
+
+class BASE_EXPORT FormatPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    static FormatPool* instance();
+
+    bool isActive() const;
+    QSharedPointer<FormatTask> render(const QString& text, const NickMatcher& names);
+
+signals:
+    void finished();
+
+private:
+    FormatPool(QObject* parent = 0);
+
+    struct Private {
+        QThreadPool pool;
+    } d;
+};
+
+#endif // FORMATPOOL_H
@@ -0,0 +1,159 @@
+/*
+  Copyright (C) 2008-2016 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "formattemplate.h"
+#include <QCoreApplication>
+#include <QThreadStorage>
+#include <QAtomicInt>
+#include <algorithm>
+#include <QHash>
+
+// bumped whenever the language changes, every thread then compiles its
+// templates again from the new translation on next use
+static QAtomicInt generation;
+
+struct Translations
+{
+    Translations() : generation(-1) { }
+    int generation;
+    QHash<const char*, FormatTemplate> templates;
+};
+
+// a translated pattern is split into literal and placeholder segments
+// once, filling it in is then a single allocation, placeholders map to
+// arguments in ascending order the way QString::arg(a1, a2, ...) does
+
+FormatTemplate::FormatTemplate(const QString& pattern)
+{
+    d.pattern = pattern;
+    d.literal = 0;
+
+    QVector<int> numbers;
+    const int length = pattern.length();
+    int start = 0;
+    for (int i = 0; i < length; ++i) {
+        if (pattern.at(i) != QLatin1Char('%') || i + 1 >= length || !pattern.at(i + 1).isDigit())
+            continue;
+
+        int end = i + 1;
+        int number = pattern.at(end++).digitValue();
+        if (end < length && pattern.at(end).isDigit())
+            number = number * 10 + pattern.at(end++).digitValue();
+        if (number == 0)
+            continue;
+
+        if (i > start) {
+            Segment text = { -1, start, i - start };
+            d.segments += text;
+            d.literal += text.length;
+        }
+        Segment placeholder = { number, i, end - i };
+        d.segments += placeholder;
+        if (!numbers.contains(number))
+            numbers += number;
+        start = end;
+        i = end - 1;
+    }
+    if (start < length) {
+        Segment text = { -1, start, length - start };
+        d.segments += text;
+        d.literal += text.length;
+    }
+
+    std::sort(numbers.begin(), numbers.end());
+    for (int i = 0; i < d.segments.count(); ++i) {
+        if (d.segments.at(i).arg != -1)
+            d.segments[i].arg = numbers.indexOf(d.segments.at(i).arg);
+    }
+}
+
+// the templates are looked up by their untranslated source, which is a
+// string literal marked with QT_TR_NOOP(), so that formatting a line does
+// not have to go through the translators
+FormatTemplate FormatTemplate::translated(const char* context, const char* source)
+{
+    static QThreadStorage<Translations> translations;
+    Translations& local = translations.localData();
+    const int current = generation;
+    if (local.generation != current) {
+        local.templates.clear();
+        local.generation = current;
+    }
+    QHash<const char*, FormatTemplate>::const_iterator it = local.templates.constFind(source);
+    if (it == local.templates.constEnd())
+        it = local.templates.insert(source, FormatTemplate(QCoreApplication::translate(context, source)));
+    return it.value();
+}
+
+void FormatTemplate::retranslate()
+{
+    generation.ref();
+}
+
+QString FormatTemplate::arg(const QString& a1) const
+{
+    const QString* args[] = { &a1 };
+    return fill(args, 1);
+}
+
+QString FormatTemplate::arg(const QString& a1, const QString& a2) const
+{
+    const QString* args[] = { &a1, &a2 };
+    return fill(args, 2);
+}
+
+QString FormatTemplate::arg(const QString& a1, const QString& a2, const QString& a3) const
+{
+    const QString* args[] = { &a1, &a2, &a3 };
+    return fill(args, 3);
+}
+
+QString FormatTemplate::arg(const QString& a1, const QString& a2, const QString& a3, const QString& a4) const
+{
+    const QString* args[] = { &a1, &a2, &a3, &a4 };
+    return fill(args, 4);
+}
+
+QString FormatTemplate::fill(const QString* const* args, int count) const
+{
+    int length = d.literal;
+    foreach (const Segment& segment, d.segments) {
+        if (segment.arg != -1)
+            length += segment.arg < count ? args[segment.arg]->length() : segment.length;
+    }
+
+    QString result;
+    result.reserve(length);
+    foreach (const Segment& segment, d.segments) {
+        if (segment.arg != -1 && segment.arg < count)
+            result += *args[segment.arg];
+        else
+            result += d.pattern.midRef(segment.offset, segment.length);
+    }
+    return result;
+}
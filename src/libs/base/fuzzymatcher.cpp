@@ -0,0 +1,202 @@
+/*
+  Copyright (C) 2008-2016 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "fuzzymatcher.h"
+#include <algorithm>
+
+// exact and prefix matches outrank any scattered subsequence
+static const int ExactScore = 1 << 24;
+static const int PrefixScore = 1 << 23;
+
+static bool byScore(const FuzzyMatcher::Match& one, const FuzzyMatcher::Match& another)
+{
+    if (one.score != another.score)
+        return one.score > another.score;
+    return one.index < another.index;
+}
+
+FuzzyMatcher::FuzzyMatcher()
+{
+}
+
+int FuzzyMatcher::count() const
+{
+    return d.entries.count();
+}
+
+void FuzzyMatcher::clear()
+{
+    d.entries.clear();
+    d.prefixes.clear();
+}
+
+// names are indexed in lower case, together with a bit mask of the
+// characters they contain; the matches refer to the index of the name
+void FuzzyMatcher::setNames(const QStringList& names)
+{
+    clear();
+    d.entries.reserve(names.count());
+    foreach (const QString& name, names)
+        addName(name);
+}
+
+QString FuzzyMatcher::name(int index) const
+{
+    return d.entries.value(index).name;
+}
+
+bool FuzzyMatcher::contains(const QString& name) const
+{
+    QMultiMap<QString, int>::const_iterator it = d.prefixes.constFind(name.toLower());
+    for (; it != d.prefixes.constEnd() && it.key() == name.toLower(); ++it) {
+        if (d.entries.at(it.value()).name == name)
+            return true;
+    }
+    return false;
+}
+
+void FuzzyMatcher::addName(const QString& name)
+{
+    Entry entry;
+    entry.name = name;
+    entry.key = name.toLower();
+    entry.mask = mask(entry.key);
+    d.prefixes.insert(entry.key, d.entries.count());
+    d.entries += entry;
+}
+
+// the last name takes the place of the removed one, so that a single
+// user leaving does not renumber the whole index
+void FuzzyMatcher::removeName(const QString& name)
+{
+    const QString key = name.toLower();
+    QMultiMap<QString, int>::iterator it = d.prefixes.find(key);
+    while (it != d.prefixes.end() && it.key() == key && d.entries.at(it.value()).name != name)
+        ++it;
+    if (it == d.prefixes.end() || it.key() != key)
+        return;
+
+    const int index = it.value();
+    const int last = d.entries.count() - 1;
+    d.prefixes.erase(it);
+    if (index != last) {
+        const Entry moved = d.entries.at(last);
+        d.prefixes.remove(moved.key, last);
+        d.prefixes.insert(moved.key, index);
+        d.entries[index] = moved;
+    }
+    d.entries.removeLast();
+}
+
+QList<FuzzyMatcher::Match> FuzzyMatcher::match(const QString& pattern, int limit) const
+{
+    QList<Match> matches;
+    const QString lower = pattern.toLower();
+    if (lower.isEmpty() || limit <= 0)
+        return matches;
+
+    // the prefix index alone answers patterns with enough prefix matches,
+    // otherwise only the names that contain all the characters are scored
+    QVector<Match> candidates;
+    QMultiMap<QString, int>::const_iterator it = d.prefixes.lowerBound(lower);
+    for (; it != d.prefixes.constEnd() && it.key().startsWith(lower); ++it) {
+        Match match;
+        match.index = it.value();
+        match.score = score(lower, it.key());
+        candidates += match;
+    }
+    if (candidates.count() < limit) {
+        candidates.clear();
+        const quint64 bits = mask(lower);
+        for (int i = 0; i < d.entries.count(); ++i) {
+            const Entry& entry = d.entries.at(i);
+            if ((entry.mask & bits) != bits)
+                continue;
+            Match match;
+            match.index = i;
+            match.score = score(lower, entry.key);
+            if (match.score >= 0)
+                candidates += match;
+        }
+    }
+
+    const int count = qMin(limit, candidates.count());
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), byScore);
+    for (int i = 0; i < count; ++i)
+        matches += candidates.at(i);
+    return matches;
+}
+
+// scores a lower case pattern against a lower case name, or returns -1
+// if the pattern is not a subsequence of the name; consecutive characters,
+// word starts and a contiguous occurrence score higher, and so do shorter names
+int FuzzyMatcher::score(const QString& pattern, const QString& name)
+{
+    if (name == pattern)
+        return ExactScore;
+    if (name.startsWith(pattern))
+        return PrefixScore - name.length();
+
+    int score = 0;
+    int last = -2;
+    int j = 0;
+    for (int i = 0; i < name.length() && j < pattern.length(); ++i) {
+        if (name.at(i) == pattern.at(j)) {
+            score += 1;
+            if (last == i - 1)
+                score += 4;
+            if (i == 0 || !name.at(i - 1).isLetterOrNumber())
+                score += 6;
+            last = i;
+            ++j;
+        }
+    }
+    if (j < pattern.length())
+        return -1;
+
+    if (name.contains(pattern))
+        score += 4 * pattern.length();
+    return (score << 8) - qMin(name.length(), 255);
+}
+
+quint64 FuzzyMatcher::mask(const QString& text)
+{
+    quint64 bits = 0;
+    for (int i = 0; i < text.length(); ++i) {
+        const ushort c = text.at(i).unicode();
+        int bit;
+        if (c >= 'a' && c <= 'z')
+            bit = c - 'a';
+        else if (c >= '0' && c <= '9')
+            bit = 26 + c - '0';
+        else
+            bit = 36 + c % 28;
+        bits |= Q_UINT64_C(1) << bit;
+    }
+    return bits;
+}
@@ -28,12 +28,106 @@
 
 #include "messagedata.h"
 
-MessageData::MessageData()
+// raw lines are packed into chunks instead of one heap block each
+static const int ChunkSize = 64 * 1024;
+
+struct MessageArena::Chunk : public QSharedData
+{
+    QByteArray bytes;
+};
+
+MessageArena::MessageArena()
+{
+}
+
+MessageArena::~MessageArena()
+{
+}
+
+void MessageArena::store(const QByteArray& data, QExplicitlySharedDataPointer<Chunk>& chunk, int& offset)
+{
+    if (!d.chunk || (d.chunk->bytes.size() + data.size() > ChunkSize && !d.chunk->bytes.isEmpty())) {
+        // full chunks stay alive for as long as any of their lines do
+        d.chunk = new Chunk;
+        d.chunk->bytes.reserve(qMax(ChunkSize, data.size()));
+        d.nicks.clear();
+    }
+    offset = d.chunk->bytes.size();
+    d.chunk->bytes.append(data);
+    chunk = d.chunk;
+}
+
+// the same few nicks repeat on every line, share a single copy of each;
+// the pool starts over with every chunk so that it only ever holds the
+// nicks of recent lines, older lines keep their copies
+QString MessageArena::intern(const QString& nick)
+{
+    QSet<QString>::const_iterator it = d.nicks.constFind(nick);
+    if (it != d.nicks.constEnd())
+        return *it;
+    d.nicks.insert(nick);
+    return nick;
+}
+
+// merged events share one append-only list, each head knows how many belong to it
+struct MessageData::Events : public QSharedData
+{
+    void append(const MessageData& event);
+
+    QList<MessageData> list;
+    MessageData::Summary summary;
+};
+
+// the summary grows along with the list, so that summarizing a merged
+// group does not have to look at all of its events again
+void MessageData::Events::append(const MessageData& event)
+{
+    list += event;
+
+    const IrcMessage::Type type = event.type() == IrcMessage::Quit && event.isError() ? IrcMessage::Error : event.type();
+    if (!summary.types.contains(type))
+        summary.types += type;
+    summary.nicks.insert(event.nick());
+}
+
+struct MessageData::Private : public QSharedData
+{
+    Private() : own(false), error(false), reply(false), pending(false), stamped(false),
+        offset(0), length(0), count(0), id(-1), timestamp(0), type(IrcMessage::Unknown) { }
+
+    bool own : 1;
+    bool error : 1;
+    bool reply : 1;
+    bool pending : 1;
+    bool stamped : 1;
+    QString nick;
+    QString format;
+    QExplicitlySharedDataPointer<MessageArena::Chunk> chunk;
+    int offset;
+    int length;
+    int count;
+    int id;
+    qint64 timestamp;
+    IrcMessage::Type type;
+    QExplicitlySharedDataPointer<Events> events;
+};
+
+MessageData::MessageData() : d(new Private)
+{
+}
+
+MessageData::MessageData(const MessageData& other) : d(other.d)
+{
+}
+
+MessageData& MessageData::operator=(const MessageData& other)
+{
+    d = other.d;
+    return *this;
+}
+
+MessageData::~MessageData()
 {
-    d.own = false;
-    d.error = false;
-    d.reply = false;
-    d.type = IrcMessage::Unknown;
 }
 
 IrcMessage::Type MessageData::effectiveType(const IrcMessage* msg)
@@ -60,91 +154,217 @@ IrcMessage::Type MessageData::effectiveType(const IrcMessage* msg)
 
 bool MessageData::isEmpty() const
 {
-    return d.format.isEmpty();
+    return d->format.isEmpty() && !d->pending;
 }
 
 bool MessageData::isEvent() const
 {
-    return !d.reply &&
-           (d.type == IrcMessage::Join ||
-            d.type == IrcMessage::Kick ||
-            d.type == IrcMessage::Mode ||
-            d.type == IrcMessage::Nick ||
-            d.type == IrcMessage::Part ||
-            d.type == IrcMessage::Quit ||
-            d.type == IrcMessage::Topic);
+    return !d->reply &&
+           (d->type == IrcMessage::Join ||
+            d->type == IrcMessage::Kick ||
+            d->type == IrcMessage::Mode ||
+            d->type == IrcMessage::Nick ||
+            d->type == IrcMessage::Part ||
+            d->type == IrcMessage::Quit ||
+            d->type == IrcMessage::Topic);
 }
 
 bool MessageData::isError() const
 {
-    return d.error || d.type == IrcMessage::Error;
+    return d->error || d->type == IrcMessage::Error;
+}
+
+bool MessageData::isPending() const
+{
+    return d->pending;
+}
+
+void MessageData::setPending(bool pending)
+{
+    d->pending = pending;
 }
 
 QList<MessageData> MessageData::getEvents() const
 {
-    QList<MessageData> events = d.events;
-    if (events.isEmpty())
-        events += *this;
-    return events;
+    if (!d->events)
+        return QList<MessageData>() << *this;
+    if (d->count == d->events->list.count())
+        return d->events->list;
+    return d->events->list.mid(0, d->count);
+}
+
+MessageData::Summary MessageData::summary() const
+{
+    if (d->events && d->count == d->events->list.count())
+        return d->events->summary;
+
+    // a head that others have merged past, or a single line
+    Events events;
+    foreach (const MessageData& event, getEvents())
+        events.append(event);
+    return events.summary;
+}
+
+// copies of the same line share their data until either one changes
+bool MessageData::isSharedWith(const MessageData& other) const
+{
+    return d == other.d;
 }
 
 bool MessageData::canMerge(const MessageData& other) const
 {
-    return isEvent() && (!d.own || d.type != IrcMessage::Join)
-           && other.isEvent() && (!other.d.own || other.d.type != IrcMessage::Join)
-           && d.timestamp.date() == other.d.timestamp.date();
+    return isEvent() && (!d->own || d->type != IrcMessage::Join)
+           && other.isEvent() && (!other.d->own || other.d->type != IrcMessage::Join)
+           && timestamp().date() == other.timestamp().date();
 }
 
 void MessageData::merge(const MessageData& other)
 {
-    d.events = other.getEvents() << *this;
+    const QList<MessageData> events = getEvents();
+    if (other.d->events && other.d->count == other.d->events->list.count()) {
+        // nobody has appended past the other head, keep growing the same list
+        d->events = other.d->events;
+    } else {
+        d->events = new Events;
+        foreach (const MessageData& event, other.getEvents())
+            d->events->append(event);
+    }
+    foreach (const MessageData& event, events)
+        d->events->append(event);
+    d->count = d->events->list.count();
 }
 
-void MessageData::initFrom(IrcMessage* message)
+void MessageData::initFrom(IrcMessage* message, MessageArena* arena)
 {
-    d.timestamp = message->timeStamp();
-    d.data = message->toData();
-    d.nick = message->nick();
-    d.type = effectiveType(message);
-    d.own = message->isOwn();
-    d.reply = message->property("reply").toBool();
+    const QDateTime timestamp = message->timeStamp();
+    d->stamped = timestamp.isValid();
+    d->timestamp = d->stamped ? timestamp.toMSecsSinceEpoch() : 0;
+    setData(message->toData(), arena);
+    d->nick = arena ? arena->intern(message->nick()) : message->nick();
+    d->type = effectiveType(message);
+    d->own = message->isOwn();
+    d->reply = message->property("reply").toBool();
 
     if (message->type() == IrcMessage::Quit) {
         QString reason = static_cast<IrcQuitMessage*>(message)->reason();
         if (reason.contains("Ping timeout")
                 || reason.contains("Connection reset by peer")
                 || reason.contains("Remote host closed the connection")) {
-            d.error = true;
+            d->error = true;
         }
     }
 }
 
 QString MessageData::format() const
 {
-    return d.format;
+    return d->format;
 }
 
 void MessageData::setFormat(const QString& format)
 {
-    d.format = format;
+    d->format = format;
 }
 
 QString MessageData::nick() const
 {
-    return d.nick;
+    return d->nick;
 }
 
 QByteArray MessageData::data() const
 {
-    return d.data;
+    if (!d->chunk)
+        return QByteArray();
+    return QByteArray(d->chunk->bytes.constData() + d->offset, d->length);
 }
 
 QDateTime MessageData::timestamp() const
 {
-    return d.timestamp;
+    if (!d->stamped)
+        return QDateTime();
+    return QDateTime::fromMSecsSinceEpoch(d->timestamp);
+}
+
+// milliseconds since the epoch, or -1 if not stamped
+qint64 MessageData::msecs() const
+{
+    if (!d->stamped)
+        return -1;
+    return d->timestamp;
 }
 
 IrcMessage::Type MessageData::type() const
 {
-    return d.type;
+    return d->type;
+}
+
+// the line of the search index, or -1 if the message is not indexed
+int MessageData::id() const
+{
+    return d->id;
+}
+
+void MessageData::setId(int id)
+{
+    d->id = id;
+}
+
+void MessageData::setData(const QByteArray& data, MessageArena* arena)
+{
+    if (arena) {
+        arena->store(data, d->chunk, d->offset);
+    } else {
+        d->chunk = new MessageArena::Chunk;
+        d->chunk->bytes = data;
+        d->offset = 0;
+    }
+    d->length = data.length();
+}
+
+void MessageData::setEvents(const QList<MessageData>& events)
+{
+    if (events.isEmpty()) {
+        d->events.reset();
+        d->count = 0;
+    } else {
+        d->events = new Events;
+        foreach (const MessageData& event, events)
+            d->events->append(event);
+        d->count = events.count();
+    }
+}
+
+QDataStream& operator<<(QDataStream& out, const MessageData& data)
+{
+    const MessageData::Private* d = data.d.constData();
+    out << bool(d->own) << bool(d->error) << bool(d->reply) << bool(d->pending)
+        << d->nick << d->format << data.data() << bool(d->stamped) << d->timestamp
+        << qint32(d->type) << qint32(d->id) << (d->events ? data.getEvents() : QList<MessageData>());
+    return out;
+}
+
+QDataStream& operator>>(QDataStream& in, MessageData& data)
+{
+    bool own = false, error = false, reply = false, pending = false, stamped = false;
+    QString nick, format;
+    QByteArray bytes;
+    qint64 timestamp = 0;
+    qint32 type = IrcMessage::Unknown, id = -1;
+    QList<MessageData> events;
+    in >> own >> error >> reply >> pending >> nick >> format >> bytes
+       >> stamped >> timestamp >> type >> id >> events;
+
+    data = MessageData();
+    data.d->own = own;
+    data.d->error = error;
+    data.d->reply = reply;
+    data.d->pending = pending;
+    data.d->stamped = stamped;
+    data.d->nick = nick;
+    data.d->format = format;
+    data.d->timestamp = timestamp;
+    data.d->type = static_cast<IrcMessage::Type>(type);
+    data.d->id = id;
+    data.setData(bytes, 0);
+    data.setEvents(events);
+    return in;
 }
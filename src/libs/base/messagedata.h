@@ -29,16 +29,41 @@
 #ifndef MESSAGEDATA_H
 #define MESSAGEDATA_H
 
+#include <QSet>
 #include <QList>
 #include <QString>
 #include <QDateTime>
 #include <IrcMessage>
+#include <QDataStream>
+#include <QSharedDataPointer>
 #include "baseglobal.h"
 
+class BASE_EXPORT MessageArena
+{
+public:
+    MessageArena();
+    ~MessageArena();
+
+private:
+    Q_DISABLE_COPY(MessageArena)
+    friend class MessageData;
+    struct Chunk;
+    void store(const QByteArray& data, QExplicitlySharedDataPointer<Chunk>& chunk, int& offset);
+    QString intern(const QString& nick);
+
+    struct Private {
+        QExplicitlySharedDataPointer<Chunk> chunk;
+        QSet<QString> nicks;
+    } d;
+};
+
 class BASE_EXPORT MessageData
 {
 public:
     MessageData();
+    MessageData(const MessageData& other);
+    MessageData& operator=(const MessageData& other);
+    ~MessageData();
 
     static IrcMessage::Type effectiveType(const IrcMessage* msg);
 
@@ -46,10 +71,23 @@ public:
     bool isEvent() const;
     bool isError() const;
 
+    bool isPending() const;
+    void setPending(bool pending);
+
     QList<MessageData> getEvents() const;
+
+    struct Summary {
+        // event types in the order they first occurred, with
+        // IrcMessage::Error standing for disconnects
+        QList<IrcMessage::Type> types;
+        QSet<QString> nicks;
+    };
+    Summary summary() const;
+
+    bool isSharedWith(const MessageData& other) const;
     bool canMerge(const MessageData& other) const;
     void merge(const MessageData& other);
-    void initFrom(IrcMessage* message);
+    void initFrom(IrcMessage* message, MessageArena* arena = 0);
 
     QString format() const;
     void setFormat(const QString& format);
@@ -57,20 +95,25 @@ public:
     QString nick() const;
     QByteArray data() const;
     QDateTime timestamp() const;
+    qint64 msecs() const;
     IrcMessage::Type type() const;
 
+    int id() const;
+    void setId(int id);
+
 private:
-    struct Private {
-        bool own;
-        bool error;
-        bool reply;
-        QString nick;
-        QString format;
-        QByteArray data;
-        QDateTime timestamp;
-        IrcMessage::Type type;
-        QList<MessageData> events;
-    } d;
+    friend BASE_EXPORT QDataStream& operator<<(QDataStream& out, const MessageData& data);
+    friend BASE_EXPORT QDataStream& operator>>(QDataStream& in, MessageData& data);
+
+    void setData(const QByteArray& data, MessageArena* arena);
+    void setEvents(const QList<MessageData>& events);
+
+    struct Events;
+    struct Private;
+    QSharedDataPointer<Private> d;
 };
 
+BASE_EXPORT QDataStream& operator<<(QDataStream& out, const MessageData& data);
+BASE_EXPORT QDataStream& operator>>(QDataStream& in, MessageData& data);
+
 #endif // MESSAGEDATA_H
@@ -27,6 +27,9 @@
 */
 
 #include "messageformatter.h"
+#include "nickindex.h"
+#include "formatcache.h"
+#include "formattemplate.h"
 #include <IrcTextFormat>
 #include <IrcConnection>
 #include <IrcUserModel>
@@ -38,8 +41,23 @@
 #include <QTime>
 #include <QColor>
 #include <QCoreApplication>
+#include <algorithm>
 #include <QTextBoundaryFinder>
 
+struct Link
+{
+    int start;
+    int length;
+    bool channel;
+};
+
+static bool linkLessThan(const Link& one, const Link& another)
+{
+    if (one.start != another.start)
+        return one.start < another.start;
+    return one.length > another.length;
+}
+
 static QString formatSeconds(int secs)
 {
     const QDateTime time = QDateTime::fromTime_t(secs);
@@ -67,8 +85,14 @@ MessageFormatter::MessageFormatter(QObject* parent) : QObject(parent)
     d.textFormat = new IrcTextFormat(this);
     d.textFormat->setSpanFormat(IrcTextFormat::SpanClass);
 
-    d.userModel = new IrcUserModel(this);
-    connect(d.userModel, SIGNAL(namesChanged(QStringList)), this, SLOT(indexNames(QStringList)));
+    d.arena = new MessageArena;
+}
+
+MessageFormatter::~MessageFormatter()
+{
+    delete d.arena;
+    if (d.index)
+        d.index->release();
 }
 
 IrcBuffer* MessageFormatter::buffer() const
@@ -80,7 +104,11 @@ void MessageFormatter::setBuffer(IrcBuffer* buffer)
 {
     if (d.buffer != buffer) {
         d.buffer = buffer;
-        d.userModel->setChannel(qobject_cast<IrcChannel*>(buffer));
+        if (d.index)
+            d.index->release();
+        d.index = 0;
+        if (IrcChannel* channel = qobject_cast<IrcChannel*>(buffer))
+            d.index = NickIndex::acquire(channel);
     }
 }
 
@@ -91,12 +119,64 @@ IrcTextFormat* MessageFormatter::textFormat() const
 
 void MessageFormatter::setTextFormat(IrcTextFormat* format)
 {
-    d.textFormat = format;
+    if (d.textFormat != format) {
+        d.textFormat = format;
+        FormatCache::instance()->invalidate();
+    }
+}
+
+// the templates and the lines formatted with them are in the language
+// that was loaded when they were first used
+void MessageFormatter::retranslate()
+{
+    FormatTemplate::retranslate();
+    FormatCache::instance()->invalidate();
+}
+
+// the format pool renders with default text formats of its own, a custom
+// one lives on the gui thread and is only used there
+bool MessageFormatter::hasDefaultTextFormat() const
+{
+    return d.textFormat && d.textFormat->parent() == this;
+}
+
+MessageArena* MessageFormatter::arena() const
+{
+    return d.arena;
+}
+
+// a snapshot of the channel's nicks that other threads can read
+NickMatcher MessageFormatter::names() const
+{
+    if (d.index)
+        return d.index->matcher();
+    return NickMatcher();
+}
+
+// the channel's nicks that occur anywhere in the text, sorted; only
+// these can get linked when the text is formatted
+QStringList MessageFormatter::matchedNicks(const QString& text) const
+{
+    QStringList nicks;
+    if (!d.index)
+        return nicks;
+    QList<NickMatcher::Match> matches;
+    d.index->matcher().match(text, 0, text.length(), &matches);
+    foreach (const NickMatcher::Match& match, matches)
+        nicks += text.mid(match.start, match.length);
+    nicks.removeDuplicates();
+    nicks.sort();
+    return nicks;
 }
 
 MessageData MessageFormatter::formatMessage(IrcMessage* msg)
 {
+    // lines that format the same every time are looked up by their bytes
     QString fmt;
+    const QByteArray key = cacheKey(msg);
+    if (!key.isEmpty() && FormatCache::instance()->find(key, &fmt))
+        return formatClass(fmt, msg);
+
     switch (MessageData::effectiveType(msg)) {
         case IrcMessage::Away:
             fmt = formatAwayMessage(static_cast<IrcAwayMessage*>(msg));
@@ -161,92 +241,188 @@ MessageData MessageFormatter::formatMessage(IrcMessage* msg)
         default:
             break;
     }
+    if (!key.isEmpty())
+        FormatCache::instance()->insert(key, fmt);
     return formatClass(fmt, msg);
 }
 
+QByteArray MessageFormatter::cacheKey(IrcMessage* msg) const
+{
+    switch (MessageData::effectiveType(msg)) {
+        case IrcMessage::Away:
+        case IrcMessage::Invite:
+        case IrcMessage::Join:
+        case IrcMessage::Kick:
+        case IrcMessage::Mode:
+        case IrcMessage::Nick:
+        case IrcMessage::Notice:
+        case IrcMessage::Part:
+        case IrcMessage::Private:
+        case IrcMessage::Quit:
+        case IrcMessage::Topic:
+        case IrcMessage::Error:
+            break;
+        default:
+            // the rest emit extra lines or depend on more than the message
+            return QByteArray();
+    }
+
+    // replies and implicit messages format differently from the same
+    // bytes, and own messages depend on the nick of the connection
+    QByteArray key = msg->toData();
+    key += '\n';
+    key += metaObject()->className();
+    key += ' ' + QByteArray::number(int(msg->flags()));
+    key += ' ' + QByteArray::number(int(msg->isOwn()));
+    key += ' ' + QByteArray::number(FormatCache::instance()->version());
+
+    // the channel only matters for the nicks that get linked
+    if (d.index)
+        key += ' ' + matchedNicks(QString::fromUtf8(key.constData(), key.indexOf('\n'))).join(" ").toUtf8();
+    return key;
+}
+
 QString MessageFormatter::formatText(const QString& text) const
 {
-    d.textFormat->parse(text);
-
-    QString msg = d.textFormat->html();
-    if (!d.names.isEmpty()) {
-        QTextBoundaryFinder finder = QTextBoundaryFinder(QTextBoundaryFinder::Word, msg);
-        int pos = 0;
-        while (pos < msg.length()) {
-            const QChar c = msg.at(pos);
-            if (!c.isSpace()) {
-                // do not format nicks within links
-                if (c == '<' && msg.midRef(pos, 3) == "<a ") {
-                    const int end = msg.indexOf("</a>", pos + 3);
-                    if (end != -1) {
-                        pos = end + 4;
-                        continue;
-                    }
-                } else if (c == '#') {
-                    int end = pos + 1;
-                    const int length = msg.length();
-                    if (end < length && msg.at(end) == '#')
-                        ++end;
-                    while (end < length) {
-                        const QChar nextChar = msg.at(end);
-                        if (!nextChar.isLetterOrNumber() && (nextChar != '-') && (nextChar != '_'))
-                            break;
-                        ++end;
-                    }
-                    if (end - pos < 2) {
-                        ++pos;
-                        continue;
-                    }
-
-                    const QString channel = msg.mid(pos, end - pos);
-
-                    const QString formatted = QString("<a style='text-decoration:none;' href='channel:%1'>%2</a>").arg(channel, styledText(channel, Bold | Color));
-                    msg.replace(pos, channel.length(), formatted);
-                    pos += formatted.length();
-                    continue;
+    // rendered ahead of time by the format pool
+    if (!d.prerendered.isNull() && text == d.prerendered)
+        return d.html;
+
+    static const NickMatcher none;
+    return renderText(text, d.textFormat, d.index ? d.index->matcher() : none);
+}
+
+void MessageFormatter::setPrerendered(const QString& text, const QString& html)
+{
+    d.prerendered = text;
+    d.html = html;
+}
+
+// does not touch the formatter, so that it can run in the format pool
+QString MessageFormatter::renderText(const QString& text, IrcTextFormat* format, const NickMatcher& names)
+{
+    format->parse(text);
+
+    const QString html = format->html();
+    if (names.isEmpty())
+        return html;
+
+    // collect channel and nick candidates from the text between tags
+    // and entities, the links are then spliced in with a single copy
+    QList<Link> links;
+    QList<NickMatcher::Match> matches;
+    const int length = html.length();
+    int pos = 0;
+    while (pos < length) {
+        const QChar c = html.at(pos);
+        if (c == '<') {
+            // do not format nicks within links
+            int end = -1;
+            if (html.midRef(pos, 3) == "<a ") {
+                end = html.indexOf("</a>", pos + 3);
+                if (end != -1)
+                    end += 4;
+            }
+            if (end == -1) {
+                end = html.indexOf('>', pos);
+                end = end != -1 ? end + 1 : length;
+            }
+            pos = end;
+            continue;
+        } else if (c == '&') {
+            const int end = html.indexOf(';', pos);
+            pos = end != -1 ? end + 1 : length;
+            continue;
+        }
+
+        int end = pos;
+        while (end < length && html.at(end) != '<' && html.at(end) != '&')
+            ++end;
+
+        names.match(html, pos, end, &matches);
+
+        for (int i = pos; i < end; ++i) {
+            if (html.at(i) == '#') {
+                int last = i + 1;
+                if (last < end && html.at(last) == '#')
+                    ++last;
+                while (last < end) {
+                    const QChar nextChar = html.at(last);
+                    if (!nextChar.isLetterOrNumber() && (nextChar != '-') && (nextChar != '_'))
+                        break;
+                    ++last;
                 }
-                // test word start boundary
-                finder.setPosition(pos);
-                if (finder.isAtBoundary()) {
-                    QMultiHash<QChar, QString>::const_iterator it = d.names.find(c);
-                    while (it != d.names.constEnd() && it.key() == c) {
-                        const QString& user = it.value();
-                        if (msg.midRef(pos, user.length()) == user) {
-                            // test word end boundary
-                            finder.setPosition(pos + user.length());
-                            if (finder.isAtBoundary()) {
-                                const QString formatted = QString("<a style='text-decoration:none;' href='nick:%1'>%2</a>").arg(user, styledText(user, Bold | Color));
-                                msg.replace(pos, user.length(), formatted);
-                                pos += formatted.length();
-                                finder = QTextBoundaryFinder(QTextBoundaryFinder::Word, msg);
-                            }
-                        }
-                        ++it;
-                    }
+                if (last - i >= 2) {
+                    Link link = { i, last - i, true };
+                    links += link;
+                    i = last - 1;
                 }
             }
-            ++pos;
+        }
+        pos = end;
+    }
+
+    if (!matches.isEmpty()) {
+        // nicks must start and end at word boundaries
+        QTextBoundaryFinder finder(QTextBoundaryFinder::Word, html);
+        foreach (const NickMatcher::Match& match, matches) {
+            finder.setPosition(match.start);
+            if (!finder.isAtBoundary())
+                continue;
+            finder.setPosition(match.start + match.length);
+            if (!finder.isAtBoundary())
+                continue;
+            Link link = { match.start, match.length, false };
+            links += link;
         }
     }
+
+    if (links.isEmpty())
+        return html;
+
+    // leftmost and then longest candidate wins
+    std::sort(links.begin(), links.end(), linkLessThan);
+
+    QString msg;
+    int last = 0;
+    foreach (const Link& link, links) {
+        if (link.start < last)
+            continue;
+        const QString name = html.mid(link.start, link.length);
+        msg += html.midRef(last, link.start - last);
+        static const FormatTemplate anchor(QString("<a style='text-decoration:none;' href='%1:%2'>%3</a>"));
+        msg += anchor.arg(link.channel ? QString("channel") : QString("nick"), name, styled(name, Bold | Color));
+        last = link.start + link.length;
+    }
+    msg += html.midRef(last);
     return msg;
 }
 
 QString MessageFormatter::formatExpander(const QString& expander) const
 {
-    return tr("<a href='expand:' class='event' style='text-decoration:none;'>%1</a>").arg(expander);
+    const FormatTemplate link = FormatTemplate::translated(staticMetaObject.className(), QT_TR_NOOP("<a href='expand:' class='event' style='text-decoration:none;'>%1</a>"));
+    return link.arg(expander);
 }
 
 QString MessageFormatter::styledText(const QString& text, Style style) const
 {
+    return styled(text, style);
+}
+
+QString MessageFormatter::styled(const QString& text, Style style)
+{
+    const FormatTemplate bold = FormatTemplate::translated(staticMetaObject.className(), QT_TR_NOOP("<b>%1</b>"));
+    const FormatTemplate color = FormatTemplate::translated(staticMetaObject.className(), QT_TR_NOOP("<span class='nick%2'>%1</span>"));
+
     QString fmt = text;
     if (style & Bold)
-        fmt = tr("<b>%1</b>").arg(fmt);
+        fmt = bold.arg(fmt);
     if (style & (Color | Dim)) {
         int bucket = (qHash(text) % 9) + 1;
         if (style & Dim) {
             bucket = 0;
         }
-        fmt = tr("<span class='nick%2'>%1</span>").arg(fmt, QString::number(bucket));
+        fmt = color.arg(fmt, QString::number(bucket));
     }
     return fmt;
 }
@@ -274,15 +450,17 @@ QString MessageFormatter::formatInviteMessage(IrcInviteMessage* msg)
 
 QString MessageFormatter::formatJoinMessage(IrcJoinMessage* msg)
 {
-    return tr("%1 %2 joined").arg(formatExpander("!"),
-                                  formatSender(msg));
+    const FormatTemplate joined = FormatTemplate::translated(staticMetaObject.className(), QT_TR_NOOP("%1 %2 joined"));
+    return joined.arg(formatExpander("!"),
+                      formatSender(msg));
 }
 
 QString MessageFormatter::formatKickMessage(IrcKickMessage* msg)
 {
-    return tr("%1 %2 kicked %3").arg(formatExpander("!"),
-                                     formatSender(msg),
-                                     styledText(msg->user(), Bold));
+    const FormatTemplate kicked = FormatTemplate::translated(staticMetaObject.className(), QT_TR_NOOP("%1 %2 kicked %3"));
+    return kicked.arg(formatExpander("!"),
+                      formatSender(msg),
+                      styledText(msg->user(), Bold));
 }
 
 QString MessageFormatter::formatModeMessage(IrcModeMessage* msg)
@@ -293,10 +471,11 @@ QString MessageFormatter::formatModeMessage(IrcModeMessage* msg)
                                              styledText(msg->mode(), Bold),
                                              styledText(msg->argument(), Bold));
 
-    return tr("%1 %2 sets mode %3 %4").arg(formatExpander("!"),
-                                           formatSender(msg),
-                                           styledText(msg->mode(), Bold),
-                                           styledText(msg->argument(), Bold));
+    const FormatTemplate sets = FormatTemplate::translated(staticMetaObject.className(), QT_TR_NOOP("%1 %2 sets mode %3 %4"));
+    return sets.arg(formatExpander("!"),
+                    formatSender(msg),
+                    styledText(msg->mode(), Bold),
+                    styledText(msg->argument(), Bold));
 }
 
 QString MessageFormatter::formatMotdMessage(IrcMotdMessage *msg)
@@ -329,8 +508,9 @@ QString MessageFormatter::formatNamesMessage(IrcNamesMessage* msg)
 
 QString MessageFormatter::formatNickMessage(IrcNickMessage* msg)
 {
-    return tr("%1 %2 changed nick").arg(formatExpander("!"),
-                                        styledText(msg->newNick(), Bold));
+    const FormatTemplate changed = FormatTemplate::translated(staticMetaObject.className(), QT_TR_NOOP("%1 %2 changed nick"));
+    return changed.arg(formatExpander("!"),
+                       styledText(msg->newNick(), Bold));
 }
 
 QString MessageFormatter::formatNoticeMessage(IrcNoticeMessage* msg)
@@ -354,15 +534,17 @@ QString MessageFormatter::formatNoticeMessage(IrcNoticeMessage* msg)
     if (!pfx.isEmpty())
         pfx = styledText(":" + pfx, Dim);
 
+    const FormatTemplate query = FormatTemplate::translated(staticMetaObject.className(), QT_TR_NOOP("[%1%2] %3"));
     if (msg->isPrivate())
-        return tr("[%1%2] %3").arg(formatSender(msg),
-                                   pfx,
-                                   formatText(msg->content()));
+        return query.arg(formatSender(msg),
+                         pfx,
+                         formatText(msg->content()));
 
-    return tr("&lt;%1%2&gt; [%3] %4").arg(formatSender(msg),
-                                          pfx,
-                                          msg->target(),
-                                          formatText(msg->content()));
+    const FormatTemplate channel = FormatTemplate::translated(staticMetaObject.className(), QT_TR_NOOP("&lt;%1%2&gt; [%3] %4"));
+    return channel.arg(formatSender(msg),
+                       pfx,
+                       msg->target(),
+                       formatText(msg->content()));
 }
 
 #define P_(x) msg->parameters().value(x)
@@ -405,8 +587,9 @@ QString MessageFormatter::formatErrorMessage(IrcErrorMessage* msg)
 
 QString MessageFormatter::formatPartMessage(IrcPartMessage* msg)
 {
-    return tr("%1 %2 left").arg(formatExpander("!"),
-                                formatSender(msg));
+    const FormatTemplate left = FormatTemplate::translated(staticMetaObject.className(), QT_TR_NOOP("%1 %2 left"));
+    return left.arg(formatExpander("!"),
+                    formatSender(msg));
 }
 
 QString MessageFormatter::formatPongMessage(IrcPongMessage* msg)
@@ -422,18 +605,20 @@ QString MessageFormatter::formatPrivateMessage(IrcPrivateMessage* msg)
                                             formatSender(msg),
                                             msg->content().split(" ").value(0).toUpper());
 
+    const FormatTemplate action = FormatTemplate::translated(staticMetaObject.className(), QT_TR_NOOP("* %1 %2"));
     if (msg->isAction())
-        return tr("* %1 %2").arg(formatSender(msg),
-                                 formatText(msg->content()));
+        return action.arg(formatSender(msg),
+                          formatText(msg->content()));
 
     QString pfx = msg->statusPrefix();
     if (!pfx.isEmpty())
         pfx = styledText(":" + pfx, Dim);
 
-    return tr("&lt;<a style='text-decoration:none;' href='nick:%1'>%2</a>%3&gt; %4").arg(msg->nick(),
-                                                                                         formatSender(msg),
-                                                                                         pfx,
-                                                                                         formatText(msg->content()));
+    const FormatTemplate message = FormatTemplate::translated(staticMetaObject.className(), QT_TR_NOOP("&lt;<a style='text-decoration:none;' href='nick:%1'>%2</a>%3&gt; %4"));
+    return message.arg(msg->nick(),
+                       formatSender(msg),
+                       pfx,
+                       formatText(msg->content()));
 }
 
 QString MessageFormatter::formatQuitMessage(IrcQuitMessage* msg)
@@ -442,11 +627,13 @@ QString MessageFormatter::formatQuitMessage(IrcQuitMessage* msg)
     if (reason.contains("Ping timeout")
             || reason.contains("Connection reset by peer")
             || reason.contains("Remote host closed the connection")) {
-        return tr("%1 %2 disconnected").arg(formatExpander("!"),
-                                            formatSender(msg));
-    }
-    return tr("%1 %2 quit").arg(formatExpander("!"),
+        const FormatTemplate disconnected = FormatTemplate::translated(staticMetaObject.className(), QT_TR_NOOP("%1 %2 disconnected"));
+        return disconnected.arg(formatExpander("!"),
                                 formatSender(msg));
+    }
+    const FormatTemplate quit = FormatTemplate::translated(staticMetaObject.className(), QT_TR_NOOP("%1 %2 quit"));
+    return quit.arg(formatExpander("!"),
+                    formatSender(msg));
 }
 
 QString MessageFormatter::formatTopicMessage(IrcTopicMessage* msg)
@@ -516,7 +703,7 @@ QString MessageFormatter::formatWhoReplyMessage(IrcWhoReplyMessage* msg)
 MessageData MessageFormatter::formatClass(const QString& format, IrcMessage* msg) const
 {
     MessageData data;
-    data.initFrom(msg);
+    data.initFrom(msg, d.arena);
 
     QString cls = "message";
     switch (data.type()) {
@@ -559,8 +746,9 @@ MessageData MessageFormatter::formatClass(const QString& format, IrcMessage* msg
             break;
     }
 
+    const FormatTemplate span = FormatTemplate::translated(staticMetaObject.className(), QT_TR_NOOP("<span class='%1'>%2</span>"));
     if (!format.isEmpty())
-        data.setFormat(tr("<span class='%1'>%2</span>").arg(cls, format));
+        data.setFormat(span.arg(cls, format));
     return data;
 }
 
@@ -574,12 +762,3 @@ QString MessageFormatter::formatSender(IrcMessage* msg) const
     }
     return styledText(msg->nick(), style);
 }
-
-void MessageFormatter::indexNames(const QStringList& names)
-{
-    d.names.clear();
-    foreach (const QString& name, names) {
-        if (!name.isEmpty())
-            d.names.insert(name.at(0), name);
-    }
-}
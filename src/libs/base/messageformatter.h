@@ -32,14 +32,16 @@
 #include <QHash>
 #include <QColor>
 #include <QString>
+#include <QPointer>
 #include <QDateTime>
 #include <IrcGlobal>
 #include <IrcMessage>
 #include "baseglobal.h"
 #include "messagedata.h"
+#include "nickmatcher.h"
 
 class IrcBuffer;
-class IrcUserModel;
+class NickIndex;
 class IrcTextFormat;
 
 class BASE_EXPORT MessageFormatter : public QObject
@@ -50,15 +52,25 @@ class BASE_EXPORT MessageFormatter : public QObject
 
 public:
     explicit MessageFormatter(QObject* parent = 0);
+    ~MessageFormatter();
 
     IrcBuffer* buffer() const;
     void setBuffer(IrcBuffer* buffer);
 
     IrcTextFormat* textFormat() const;
     void setTextFormat(IrcTextFormat* format);
+    bool hasDefaultTextFormat() const;
+
+    static void retranslate();
+
+    MessageArena* arena() const;
+    NickMatcher names() const;
+    QStringList matchedNicks(const QString& text) const;
 
     MessageData formatMessage(IrcMessage* msg);
     QString formatText(const QString& text) const;
+    void setPrerendered(const QString& text, const QString& html);
+    static QString renderText(const QString& text, IrcTextFormat* format, const NickMatcher& names);
 
     enum StyleFlag
     {
@@ -70,6 +82,7 @@ public:
     Q_DECLARE_FLAGS(Style, StyleFlag)
 
     QString styledText(const QString& text, Style style) const;
+    static QString styled(const QString& text, Style style);
 
 signals:
     void formatted(const MessageData& msg);
@@ -100,15 +113,16 @@ protected:
     virtual QString formatSender(IrcMessage* msg) const;
     virtual QString formatExpander(const QString& expander) const;
 
-private slots:
-    void indexNames(const QStringList& names);
-
 private:
+    QByteArray cacheKey(IrcMessage* msg) const;
+
     struct Private {
         IrcBuffer* buffer;
-        IrcUserModel* userModel;
+        QPointer<NickIndex> index;
         IrcTextFormat* textFormat;
-        QMultiHash<QChar, QString> names;
+        MessageArena* arena;
+        QString prerendered;
+        QString html;
     } d;
 };
 
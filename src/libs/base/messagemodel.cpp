@@ -0,0 +1,236 @@
+/*
+  Copyright (C) 2008-2016 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "messagemodel.h"
+#include "textdocument.h"
+#include <algorithm>
+
+MessageModel::MessageModel(TextDocument* document) : QAbstractListModel(document)
+{
+    d.offset = 0;
+    d.lowlight = -1;
+    d.maximum = 100000;
+    d.document = document;
+}
+
+TextDocument* MessageModel::document() const
+{
+    return d.document;
+}
+
+int MessageModel::count() const
+{
+    return d.messages.count();
+}
+
+// the amount of rows trimmed from the top so far; offset + row is a
+// stable key for a message while the model keeps trimming old rows
+int MessageModel::offset() const
+{
+    return d.offset;
+}
+
+int MessageModel::maximumCount() const
+{
+    return d.maximum;
+}
+
+void MessageModel::setMaximumCount(int count)
+{
+    if (d.maximum != count) {
+        d.maximum = count;
+        trim(true);
+    }
+}
+
+MessageData MessageModel::message(int row) const
+{
+    return d.messages.value(row);
+}
+
+int MessageModel::lowlight() const
+{
+    return d.lowlight;
+}
+
+void MessageModel::setLowlight(int row)
+{
+    if (d.lowlight != row) {
+        d.lowlight = row;
+        emit lowlightChanged(row);
+    }
+}
+
+QList<int> MessageModel::highlights() const
+{
+    return d.highlights;
+}
+
+bool MessageModel::isHighlighted(int row) const
+{
+    return std::binary_search(d.highlights.constBegin(), d.highlights.constEnd(), row);
+}
+
+void MessageModel::setHighlighted(int row, bool highlighted)
+{
+    if (row < 0 || row >= d.messages.count() || isHighlighted(row) == highlighted)
+        return;
+
+    if (highlighted) {
+        QList<int>::iterator it = std::lower_bound(d.highlights.begin(), d.highlights.end(), row);
+        d.highlights.insert(it, row);
+    } else {
+        d.highlights.removeOne(row);
+    }
+    const QModelIndex idx = index(row);
+    emit dataChanged(idx, idx);
+}
+
+int MessageModel::firstUnseen(const QDateTime& timestamp) const
+{
+    // Note: The following logic assumes the messages are ordered by time
+    const qint64 msecs = timestamp.isValid() ? timestamp.toMSecsSinceEpoch() : -1;
+    int row = -1;
+    for (int i = d.messages.count() - 1; i >= 0; --i) {
+        if (d.messages.at(i).msecs() <= msecs)
+            break;
+        row = i;
+    }
+    return row;
+}
+
+// the row of the given search index line, or -1 if it has been trimmed
+int MessageModel::rowAt(int id) const
+{
+    for (int i = d.messages.count() - 1; i >= 0; --i) {
+        const int other = d.messages.at(i).id();
+        if (other == id)
+            return i;
+        if (other >= 0 && other < id)
+            break;
+    }
+    return -1;
+}
+
+int MessageModel::rowCount(const QModelIndex& parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return d.messages.count();
+}
+
+QVariant MessageModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= d.messages.count())
+        return QVariant();
+
+    const MessageData& message = d.messages.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+        return d.document->formatBlock(message.msecs(), message.format());
+    case Qt::TextAlignmentRole:
+        return int(message.type() == IrcMessage::Unknown ? Qt::AlignRight : Qt::AlignLeft);
+    case TimestampRole:
+        return message.timestamp();
+    case TypeRole:
+        return message.type();
+    case HighlightRole:
+        return isHighlighted(index.row());
+    default:
+        return QVariant();
+    }
+}
+
+void MessageModel::clear()
+{
+    beginResetModel();
+    d.offset += d.messages.count();
+    d.messages.clear();
+    d.highlights.clear();
+    d.lowlight = -1;
+    endResetModel();
+}
+
+void MessageModel::append(const MessageData& message)
+{
+    const int row = d.messages.count();
+    beginInsertRows(QModelIndex(), row, row);
+    d.messages.append(message);
+    endInsertRows();
+    trim();
+}
+
+void MessageModel::append(const QList<MessageData>& messages)
+{
+    if (messages.isEmpty())
+        return;
+
+    const int row = d.messages.count();
+    beginInsertRows(QModelIndex(), row, row + messages.count() - 1);
+    d.messages += messages;
+    endInsertRows();
+    trim();
+}
+
+void MessageModel::replaceLast(const MessageData& message)
+{
+    if (d.messages.isEmpty()) {
+        append(message);
+    } else {
+        const int row = d.messages.count() - 1;
+        d.messages.replace(row, message);
+        const QModelIndex idx = index(row);
+        emit dataChanged(idx, idx);
+    }
+}
+
+// a full model is trimmed in chunks, so that appending at capacity does
+// not shift the whole list and the highlights for every single message
+void MessageModel::trim(bool force)
+{
+    const int diff = d.messages.count() - d.maximum;
+    const int chunk = force ? 1 : qBound(1, d.maximum / 16, 1024);
+    if (diff < chunk || d.maximum < 0)
+        return;
+
+    beginRemoveRows(QModelIndex(), 0, diff - 1);
+    d.messages.erase(d.messages.begin(), d.messages.begin() + diff);
+    d.offset += diff;
+
+    QList<int>::iterator it = d.highlights.begin();
+    while (it != d.highlights.end()) {
+        *it -= diff;
+        if (*it < 0)
+            it = d.highlights.erase(it);
+        else
+            ++it;
+    }
+    if (d.lowlight != -1)
+        d.lowlight = qMax(-1, d.lowlight - diff);
+    endRemoveRows();
+}
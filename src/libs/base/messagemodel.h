@@ -0,0 +1,98 @@
+/*
+  Copyright (C) 2008-2016 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MESSAGEMODEL_H
+#define MESSAGEMODEL_H
+
+#include <QAbstractListModel>
+#include <QDateTime>
+#include <QList>
+#include "baseglobal.h"
+#include "messagedata.h"
+
+class TextDocument;
+
+class BASE_EXPORT MessageModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Role {
+        TimestampRole = Qt::UserRole,
+        TypeRole,
+        HighlightRole
+    };
+
+    explicit MessageModel(TextDocument* document);
+
+    TextDocument* document() const;
+
+    int count() const;
+    int offset() const;
+
+    int maximumCount() const;
+    void setMaximumCount(int count);
+
+    MessageData message(int row) const;
+
+    int lowlight() const;
+    void setLowlight(int row);
+
+    QList<int> highlights() const;
+    bool isHighlighted(int row) const;
+    void setHighlighted(int row, bool highlighted);
+
+    int firstUnseen(const QDateTime& timestamp) const;
+    int rowAt(int id) const;
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+
+public slots:
+    void clear();
+    void append(const MessageData& message);
+    void append(const QList<MessageData>& messages);
+    void replaceLast(const MessageData& message);
+
+signals:
+    void lowlightChanged(int row);
+
+private:
+    void trim(bool force = false);
+
+    struct Private {
+        int offset;
+        int lowlight;
+        int maximum;
+        TextDocument* document;
+        QList<int> highlights;
+        QList<MessageData> messages;
+    } d;
+};
+
+#endif // MESSAGEMODEL_H
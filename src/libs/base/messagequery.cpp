@@ -0,0 +1,392 @@
+/*
+  Copyright (C) 2008-2016 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "messagequery.h"
+#include "messagedata.h"
+#include <QCoreApplication>
+#include <QDateTime>
+
+#if QT_VERSION >= 0x050e00
+static const Qt::SplitBehavior SkipEmptyParts = Qt::SkipEmptyParts;
+#else
+static const QString::SplitBehavior SkipEmptyParts = QString::SkipEmptyParts;
+#endif
+
+static const struct {
+    const char* name;
+    IrcMessage::Type type;
+} Types[] = {
+    { "message", IrcMessage::Private },
+    { "notice", IrcMessage::Notice },
+    { "join", IrcMessage::Join },
+    { "part", IrcMessage::Part },
+    { "quit", IrcMessage::Quit },
+    { "kick", IrcMessage::Kick },
+    { "mode", IrcMessage::Mode },
+    { "nick", IrcMessage::Nick },
+    { "topic", IrcMessage::Topic },
+    { "invite", IrcMessage::Invite },
+    { "numeric", IrcMessage::Numeric },
+    { "error", IrcMessage::Error }
+};
+
+// "30m", "2h" or "7d" count back from now, "hh:mm[:ss]" is today and
+// "yyyy-MM-dd[Thh:mm[:ss]]" is local time
+static qint64 parseTime(const QString& value)
+{
+    if (value.length() > 1) {
+        bool ok = false;
+        const qint64 count = value.left(value.length() - 1).toLongLong(&ok);
+        if (ok && count >= 0) {
+            qint64 factor = 0;
+            switch (value.at(value.length() - 1).toLower().unicode()) {
+            case 's': factor = 1000; break;
+            case 'm': factor = 60 * 1000; break;
+            case 'h': factor = 60 * 60 * 1000; break;
+            case 'd': factor = 24 * 60 * 60 * 1000; break;
+            default: break;
+            }
+            if (factor)
+                return QDateTime::currentMSecsSinceEpoch() - count * factor;
+        }
+    }
+
+    QDateTime timestamp = QDateTime::fromString(value, Qt::ISODate);
+    if (!timestamp.isValid()) {
+        const QDate date = QDate::fromString(value, Qt::ISODate);
+        if (date.isValid()) {
+#if QT_VERSION >= 0x050e00
+            timestamp = date.startOfDay();
+#else
+            timestamp = QDateTime(date);
+#endif
+        }
+    }
+    if (!timestamp.isValid()) {
+        QTime time = QTime::fromString(value, "h:mm:ss");
+        if (!time.isValid())
+            time = QTime::fromString(value, "h:mm");
+        if (time.isValid())
+            timestamp = QDateTime(QDate::currentDate(), time);
+    }
+    return timestamp.isValid() ? timestamp.toMSecsSinceEpoch() : -1;
+}
+
+MessageQuery::MessageQuery()
+{
+    d.syntax = PlainText;
+    d.highlighted = false;
+    d.after = -1;
+    d.before = -1;
+}
+
+MessageQuery::MessageQuery(const QString& query, Syntax syntax)
+{
+    d.syntax = syntax;
+    d.source = query;
+    d.highlighted = false;
+    d.after = -1;
+    d.before = -1;
+
+    if (syntax == Structured)
+        parse(query);
+    else if (!query.isEmpty())
+        d.words += query;
+
+    // the skip tables are built once, not for every message
+    foreach (const QString& word, d.words)
+        d.matchers += QStringMatcher(word, Qt::CaseInsensitive);
+}
+
+QString MessageQuery::toString() const
+{
+    return d.source;
+}
+
+MessageQuery::Syntax MessageQuery::syntax() const
+{
+    return d.syntax;
+}
+
+bool MessageQuery::isEmpty() const
+{
+    return d.words.isEmpty() && d.regex.isEmpty() && d.nicks.isEmpty() && d.types.isEmpty()
+            && !d.highlighted && d.after == -1 && d.before == -1;
+}
+
+bool MessageQuery::isValid() const
+{
+    return d.error.isEmpty();
+}
+
+QString MessageQuery::errorString() const
+{
+    return d.error;
+}
+
+// whether everything this query matches is known to be matched by the
+// other one too, so that only the other's matches need to be re-checked
+bool MessageQuery::refines(const MessageQuery& other) const
+{
+    if (other.isEmpty() || !isValid() || !other.isValid())
+        return false;
+    if (other.d.highlighted && !d.highlighted)
+        return false;
+    if (other.d.after != -1 && (d.after == -1 || d.after < other.d.after))
+        return false;
+    if (other.d.before != -1 && (d.before == -1 || d.before > other.d.before))
+        return false;
+    if (!other.d.regex.isEmpty() && d.regex.pattern() != other.d.regex.pattern())
+        return false;
+
+    // nicks and types are alternatives, so fewer of them narrow it down
+    if (!other.d.nicks.isEmpty()) {
+        if (d.nicks.isEmpty())
+            return false;
+        foreach (const QString& nick, d.nicks) {
+            if (!other.matchesNick(nick))
+                return false;
+        }
+    }
+    if (!other.d.types.isEmpty()) {
+        if (d.types.isEmpty())
+            return false;
+        foreach (IrcMessage::Type type, d.types) {
+            if (!other.matchesType(type))
+                return false;
+        }
+    }
+
+    // words must all match, so each of the other's must be within one of these
+    foreach (const QString& word, other.d.words) {
+        bool found = false;
+        foreach (const QString& longer, d.words)
+            found |= longer.contains(word, Qt::CaseInsensitive);
+        if (!found)
+            return false;
+    }
+    return true;
+}
+
+// the cheap structured fields are checked first, and the formatted
+// message is only stripped down to plain text when there is text to match
+bool MessageQuery::matches(const MessageData& message, bool highlighted) const
+{
+    if (d.highlighted && !highlighted)
+        return false;
+
+    if (d.after != -1 || d.before != -1) {
+        const qint64 msecs = message.msecs();
+        if (msecs < 0 || (d.after != -1 && msecs < d.after) || (d.before != -1 && msecs >= d.before))
+            return false;
+    }
+
+    if (!d.types.isEmpty() || !d.nicks.isEmpty()) {
+        if (message.isEvent()) {
+            const MessageData::Summary summary = message.summary();
+            if (!d.types.isEmpty()) {
+                bool found = false;
+                foreach (IrcMessage::Type type, summary.types)
+                    found |= matchesType(type);
+                if (!found)
+                    return false;
+            }
+            if (!d.nicks.isEmpty()) {
+                bool found = false;
+                foreach (const QString& nick, summary.nicks)
+                    found |= matchesNick(nick);
+                if (!found)
+                    return false;
+            }
+        } else {
+            const IrcMessage::Type type = message.isError() ? IrcMessage::Error : message.type();
+            if (!d.types.isEmpty() && !matchesType(type))
+                return false;
+            if (!d.nicks.isEmpty() && !matchesNick(message.nick()))
+                return false;
+        }
+    }
+
+    if (!d.matchers.isEmpty() || !d.regex.isEmpty()) {
+        const QString text = plainText(message.format());
+        foreach (const QStringMatcher& matcher, d.matchers) {
+            if (matcher.indexIn(text) == -1)
+                return false;
+        }
+        if (!d.regex.isEmpty() && d.regex.indexIn(text) == -1)
+            return false;
+    }
+    return true;
+}
+
+bool MessageQuery::operator==(const MessageQuery& other) const
+{
+    return d.syntax == other.d.syntax && d.source == other.d.source;
+}
+
+bool MessageQuery::operator!=(const MessageQuery& other) const
+{
+    return !(*this == other);
+}
+
+// a cheap tag stripper, good enough for matching against formatted messages
+QString MessageQuery::plainText(const QString& html)
+{
+    QString text;
+    text.reserve(html.length());
+    bool tag = false;
+    for (int i = 0; i < html.length(); ++i) {
+        const QChar c = html.at(i);
+        if (c == QLatin1Char('<'))
+            tag = true;
+        else if (c == QLatin1Char('>'))
+            tag = false;
+        else if (!tag)
+            text += c;
+    }
+    if (text.contains(QLatin1Char('&'))) {
+        text.replace(QLatin1String("&lt;"), QLatin1String("<"));
+        text.replace(QLatin1String("&gt;"), QLatin1String(">"));
+        text.replace(QLatin1String("&quot;"), QLatin1String("\""));
+        text.replace(QLatin1String("&nbsp;"), QLatin1String(" "));
+        text.replace(QLatin1String("&amp;"), QLatin1String("&"));
+    }
+    return text;
+}
+
+// terms are separated by whitespace, "quoted phrases" are taken as text
+// as is and /regular expressions/ may contain whitespace too; the last
+// term is still being typed unless the query ends with whitespace
+void MessageQuery::parse(const QString& query)
+{
+    QString term;
+    QChar quote;
+    for (int i = 0; i <= query.length(); ++i) {
+        const QChar c = i < query.length() ? query.at(i) : QChar();
+        if (!quote.isNull()) {
+            if (c.isNull() || (c == quote && !term.endsWith(QLatin1Char('\\')))) {
+                if (quote == QLatin1Char('/'))
+                    addRegExp(term);
+                else
+                    addTerm(term, true);
+                term.clear();
+                quote = QChar();
+            } else {
+                term += c;
+            }
+        } else if (c.isNull() || c.isSpace()) {
+            addTerm(term, false, c.isNull());
+            term.clear();
+        } else if (term.isEmpty() && (c == QLatin1Char('"') || c == QLatin1Char('/'))) {
+            quote = c;
+        } else {
+            term += c;
+        }
+    }
+}
+
+// a partial term that does not make sense yet is left out instead of
+// flagging an error on every keystroke
+void MessageQuery::addTerm(const QString& term, bool literal, bool partial)
+{
+    if (term.isEmpty())
+        return;
+
+    const int colon = literal ? -1 : term.indexOf(QLatin1Char(':'));
+    if (colon > 0) {
+        const QString key = term.left(colon).toLower();
+        const QString value = term.mid(colon + 1);
+        if (key == "nick" || key == "from") {
+            d.nicks += value.split(QLatin1Char(','), SkipEmptyParts);
+            return;
+        }
+        if (key == "type") {
+            // abbreviated names match every type they are a prefix of
+            foreach (const QString& name, value.split(QLatin1Char(','), SkipEmptyParts)) {
+                bool found = false;
+                for (uint i = 0; i < sizeof(Types) / sizeof(Types[0]); ++i) {
+                    if (QLatin1String(Types[i].name).startsWith(name, Qt::CaseInsensitive)) {
+                        if (!d.types.contains(Types[i].type))
+                            d.types += Types[i].type;
+                        found = true;
+                    }
+                }
+                if (!found && !partial)
+                    d.error = QCoreApplication::translate("MessageQuery", "Unknown type: %1").arg(name);
+            }
+            return;
+        }
+        if (key == "after" || key == "since" || key == "before" || key == "until") {
+            const qint64 msecs = parseTime(value);
+            if (msecs == -1) {
+                if (!value.isEmpty() && !partial)
+                    d.error = QCoreApplication::translate("MessageQuery", "Unknown time: %1").arg(value);
+            } else if (key == "after" || key == "since") {
+                d.after = msecs;
+            } else {
+                d.before = msecs;
+            }
+            return;
+        }
+        if (key == "is") {
+            if (value.startsWith("highlight", Qt::CaseInsensitive))
+                d.highlighted = true;
+            else if (!value.isEmpty() && !(partial && QString("highlight").startsWith(value, Qt::CaseInsensitive)))
+                d.error = QCoreApplication::translate("MessageQuery", "Unknown condition: %1").arg(value);
+            return;
+        }
+    }
+
+    d.words += term;
+}
+
+void MessageQuery::addRegExp(const QString& pattern)
+{
+    if (pattern.isEmpty())
+        return;
+
+    d.regex = QRegExp(pattern, Qt::CaseInsensitive, QRegExp::RegExp2);
+    if (!d.regex.isValid()) {
+        d.error = d.regex.errorString();
+        d.regex = QRegExp();
+    }
+}
+
+bool MessageQuery::matchesType(IrcMessage::Type type) const
+{
+    return d.types.contains(type);
+}
+
+bool MessageQuery::matchesNick(const QString& nick) const
+{
+    foreach (const QString& other, d.nicks) {
+        if (!nick.compare(other, Qt::CaseInsensitive))
+            return true;
+    }
+    return false;
+}
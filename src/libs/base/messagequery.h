@@ -0,0 +1,87 @@
+/*
+  Copyright (C) 2008-2016 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MESSAGEQUERY_H
+#define MESSAGEQUERY_H
+
+#include <QStringMatcher>
+#include <QStringList>
+#include <IrcMessage>
+#include <QRegExp>
+#include <QString>
+#include <QList>
+#include "baseglobal.h"
+
+class MessageData;
+
+class BASE_EXPORT MessageQuery
+{
+public:
+    enum Syntax { PlainText, Structured };
+
+    MessageQuery();
+    explicit MessageQuery(const QString& query, Syntax syntax = Structured);
+
+    QString toString() const;
+    Syntax syntax() const;
+
+    bool isEmpty() const;
+    bool isValid() const;
+    QString errorString() const;
+
+    bool refines(const MessageQuery& other) const;
+    bool matches(const MessageData& message, bool highlighted = false) const;
+
+    bool operator==(const MessageQuery& other) const;
+    bool operator!=(const MessageQuery& other) const;
+
+    static QString plainText(const QString& html);
+
+private:
+    void parse(const QString& query);
+    void addTerm(const QString& term, bool literal, bool partial = false);
+    void addRegExp(const QString& pattern);
+    bool matchesType(IrcMessage::Type type) const;
+    bool matchesNick(const QString& nick) const;
+
+    struct Private {
+        Syntax syntax;
+        QString source;
+        QString error;
+        bool highlighted;
+        qint64 after;
+        qint64 before;
+        QStringList nicks;
+        QList<IrcMessage::Type> types;
+        QStringList words;
+        QList<QStringMatcher> matchers;
+        QRegExp regex;
+    } d;
+};
+
+#endif // MESSAGEQUERY_H
@@ -0,0 +1,734 @@
+/*
+  Copyright (C) 2008-2016 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "messageview.h"
+#include "messagemodel.h"
+#include "textdocument.h"
+#include "textframe.h"
+#include <QAbstractTextDocumentLayout>
+#include <QDesktopServices>
+#include <QApplication>
+#include <QTextDocument>
+#include <QTextCursor>
+#include <QScrollBar>
+#include <IrcCommand>
+#include <QClipboard>
+#include <IrcBuffer>
+#include <QKeyEvent>
+#include <QPainter>
+#include <QToolTip>
+#include <QAction>
+#include <QMenu>
+#include <algorithm>
+#include <qmath.h>
+
+MessageView::MessageView(QWidget* parent) : QAbstractScrollArea(parent)
+{
+    d.bud = 0;
+    d.bottom = true;
+    d.marker = -1;
+    d.current = -1;
+    d.width = 0;
+    d.removed = 0;
+    d.estimate = 0;
+    d.valid = 0;
+    d.tops.resize(1);
+    d.layouts.setMaxCost(256);
+
+    setFrameShape(QFrame::NoFrame);
+    setFocusPolicy(Qt::ClickFocus);
+    setContextMenuPolicy(Qt::CustomContextMenu);
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    viewport()->setMouseTracking(true);
+
+    d.lowlightFrame = new TextLowlight(viewport());
+    d.highlightFrame = new TextHighlight(viewport());
+}
+
+MessageView::~MessageView()
+{
+    TextDocument* doc = d.document;
+    if (doc) {
+        if (doc->isClone())
+            delete doc;
+        else
+            doc->setVisible(false);
+    }
+}
+
+IrcBuffer* MessageView::buffer() const
+{
+    if (d.document)
+        return d.document->buffer();
+    return 0;
+}
+
+TextDocument* MessageView::document() const
+{
+    return d.document;
+}
+
+void MessageView::setDocument(TextDocument* document)
+{
+    if (d.document != document) {
+        if (d.document)
+            d.document->setVisible(false);
+        if (d.model)
+            disconnect(d.model, 0, this, 0);
+
+        d.document = document;
+        d.model = document ? document->messageModel() : 0;
+        d.marker = -1;
+        d.current = -1;
+        d.filter = MessageQuery();
+
+        if (document) {
+            // locate the scrollback marker before the document gets marked as seen
+            d.marker = d.model->firstUnseen(document->latestMessageSeen());
+            document->setVisible(true);
+
+            connect(d.model, SIGNAL(rowsInserted(QModelIndex,int,int)), this, SLOT(onRowsInserted(QModelIndex,int,int)));
+            connect(d.model, SIGNAL(rowsAboutToBeRemoved(QModelIndex,int,int)), this, SLOT(onRowsAboutToBeRemoved(QModelIndex,int,int)));
+            connect(d.model, SIGNAL(rowsRemoved(QModelIndex,int,int)), this, SLOT(onRowsRemoved(QModelIndex,int,int)));
+            connect(d.model, SIGNAL(dataChanged(QModelIndex,QModelIndex)), this, SLOT(onDataChanged(QModelIndex,QModelIndex)));
+            connect(d.model, SIGNAL(modelReset()), this, SLOT(onModelReset()));
+            connect(d.model, SIGNAL(lowlightChanged(int)), viewport(), SLOT(update()));
+        }
+
+        d.bottom = true;
+        relayout();
+        emit documentChanged(document);
+    }
+}
+
+QWidget* MessageView::buddy() const
+{
+    return d.bud;
+}
+
+void MessageView::setBuddy(QWidget* buddy)
+{
+    d.bud = buddy;
+}
+
+bool MessageView::isAtTop() const
+{
+    return verticalScrollBar()->value() <= verticalScrollBar()->minimum();
+}
+
+bool MessageView::isAtBottom() const
+{
+    return verticalScrollBar()->value() >= verticalScrollBar()->maximum();
+}
+
+int MessageView::rowAt(const QPoint& pos) const
+{
+    const int count = d.heights.count();
+    if (!count)
+        return -1;
+
+    const int y = pos.y() + verticalScrollBar()->value() - margin();
+    if (y < 0 || y >= rowTop(count))
+        return -1;
+
+    // tops are ascending - find the last row that starts at or above y
+    QVector<int>::const_iterator it = std::upper_bound(d.tops.constBegin(), d.tops.constBegin() + count, y);
+    return qMax(0, int(it - d.tops.constBegin()) - 1);
+}
+
+QRect MessageView::rowRect(int row) const
+{
+    if (row < 0 || row >= d.heights.count())
+        return QRect();
+    const int top = margin() + rowTop(row) - verticalScrollBar()->value();
+    return QRect(margin(), top, d.width, rowHeight(row));
+}
+
+QString MessageView::anchorAt(const QPoint& pos) const
+{
+    const int row = rowAt(pos);
+    if (row == -1)
+        return QString();
+
+    const QRect rect = rowRect(row);
+    QTextDocument* doc = rowDocument(row);
+    return doc->documentLayout()->anchorAt(pos - rect.topLeft());
+}
+
+int MessageView::currentRow() const
+{
+    return d.current;
+}
+
+// the row found by the finder, marked and scrolled into view
+void MessageView::setCurrentRow(int row)
+{
+    if (d.current != row) {
+        d.current = row;
+        if (row != -1)
+            scrollToRow(row);
+        viewport()->update();
+    }
+}
+
+MessageQuery MessageView::filter() const
+{
+    return d.filter;
+}
+
+// the filter belongs to the view, so that split views of the same buffer
+// can filter the shared model differently; filtered rows keep their
+// measured heights, they just take no space
+void MessageView::setFilter(const MessageQuery& filter)
+{
+    if (d.filter == filter)
+        return;
+
+    const bool narrower = filter.refines(d.filter);
+    d.filter = filter;
+    refilter(narrower);
+    d.valid = 0;
+    updateScrollBar();
+    viewport()->update();
+}
+
+bool MessageView::isFiltered(int row) const
+{
+    if (row < 0)
+        return false;
+    return row < firstRow() || (row < d.hidden.count() && d.hidden.at(row));
+}
+
+// the rows of the shared model before the document was last cleared
+int MessageView::firstRow() const
+{
+    if (!d.document || !d.model)
+        return 0;
+    return qMax(0, d.document->rowOffset() - d.model->offset());
+}
+
+QMenu* MessageView::createContextMenu(const QPoint& pos)
+{
+    QMenu* menu = new QMenu(this);
+
+    const QString anchor = anchorAt(pos);
+    if (anchor.startsWith("nick:")) {
+        const QString nick = QUrl(anchor).toString(QUrl::RemoveScheme | QUrl::RemoveFragment | QUrl::FullyDecoded);
+        menu->addAction(nick)->setEnabled(false);
+        menu->addSeparator();
+        menu->addAction(tr("Whois"), this, SLOT(onWhoisTriggered()))->setData(nick);
+        menu->addAction(tr("Query"), this, SLOT(onQueryTriggered()))->setData(nick);
+    } else if (anchor.startsWith("channel:")) {
+        const QString channel = anchor.mid(8);
+        menu->addAction(channel)->setEnabled(false);
+        menu->addSeparator();
+        menu->addAction(tr("Join"), this, SLOT(onJoinTriggered()))->setData(channel);
+    } else if (!anchor.isEmpty() && !anchor.startsWith("expand:")) {
+        menu->addAction(tr("Copy Link Location"), this, SLOT(onCopyTriggered()))->setData(anchor);
+    }
+
+    const int row = rowAt(pos);
+    if (row != -1) {
+        if (!menu->isEmpty())
+            menu->addSeparator();
+        menu->addAction(tr("Copy"), this, SLOT(onCopyTriggered()))->setData(rowDocument(row)->toPlainText());
+    }
+    return menu;
+}
+
+// like the text browser, clears the document of this view only, the rows
+// it shares with the other views of the buffer are just no longer shown
+void MessageView::clear()
+{
+    if (!d.document)
+        return;
+
+    d.document->reset();
+    d.marker = -1;
+    d.current = -1;
+    d.bottom = true;
+    relayout();
+}
+
+void MessageView::scrollToTop()
+{
+    verticalScrollBar()->triggerAction(QScrollBar::SliderToMinimum);
+}
+
+void MessageView::scrollToBottom()
+{
+    verticalScrollBar()->triggerAction(QScrollBar::SliderToMaximum);
+}
+
+static void scrollPage(QScrollBar* bar, qreal f)
+{
+    int add = f * bar->pageStep();
+    int pos = bar->value() + add;
+    if (add > 0 && pos < bar->value())
+        pos = bar->maximum();
+    else if (add < 0 && pos > bar->value())
+        pos = bar->minimum();
+    bar->setSliderPosition(pos);
+}
+
+void MessageView::scrollToNextPage()
+{
+    scrollPage(verticalScrollBar(), 0.667);
+}
+
+void MessageView::scrollToPreviousPage()
+{
+    scrollPage(verticalScrollBar(), -0.667);
+}
+
+void MessageView::scrollToRow(int row)
+{
+    if (row >= 0 && row < d.heights.count()) {
+        rowHeight(row);
+        updateScrollBar();
+        verticalScrollBar()->setValue(rowTop(row));
+    }
+}
+
+void MessageView::changeEvent(QEvent* event)
+{
+    QAbstractScrollArea::changeEvent(event);
+    if (event->type() == QEvent::FontChange || event->type() == QEvent::StyleChange)
+        relayout();
+}
+
+void MessageView::keyPressEvent(QKeyEvent* event)
+{
+    // see TextBrowser::keyPressEvent()
+    if (d.bud) {
+        switch (event->key()) {
+            case Qt::Key_Shift:
+            case Qt::Key_Control:
+            case Qt::Key_Meta:
+            case Qt::Key_Alt:
+            case Qt::Key_AltGr:
+            case Qt::Key_PageUp:
+            case Qt::Key_PageDown:
+                break;
+            default:
+                if (!event->matches(QKeySequence::Copy)) {
+                    QCoreApplication::sendEvent(d.bud, event);
+                    d.bud->setFocus();
+                    return;
+                }
+                break;
+        }
+    }
+    QAbstractScrollArea::keyPressEvent(event);
+}
+
+void MessageView::mouseMoveEvent(QMouseEvent* event)
+{
+    QToolTip::hideText();
+    if (anchorAt(event->pos()).isEmpty())
+        viewport()->unsetCursor();
+    else
+        viewport()->setCursor(Qt::PointingHandCursor);
+    QAbstractScrollArea::mouseMoveEvent(event);
+}
+
+void MessageView::mousePressEvent(QMouseEvent* event)
+{
+    if (event->button() == Qt::LeftButton && d.document) {
+        const QString anchor = anchorAt(event->pos());
+        const QUrl url(anchor);
+        if (url.scheme() == "expand") {
+            const QString text = d.document->tooltip(d.model->message(rowAt(event->pos())));
+            if (!text.isEmpty())
+                QToolTip::showText(event->globalPos(), text, viewport());
+        } else if (url.scheme() == "nick" || url.scheme() == "channel") {
+            QMenu* menu = createContextMenu(event->pos());
+            menu->exec(event->globalPos());
+            menu->deleteLater();
+        } else if (!anchor.isEmpty()) {
+            QDesktopServices::openUrl(url);
+        }
+        if (!anchor.isEmpty() && d.bud)
+            d.bud->setFocus();
+    }
+    QAbstractScrollArea::mousePressEvent(event);
+}
+
+void MessageView::paintEvent(QPaintEvent* event)
+{
+    if (!d.document || !d.model)
+        return;
+
+    if (d.css != d.document->styleSheet() || d.timeStampFormat != d.document->timeStampFormat()) {
+        QMetaObject::invokeMethod(this, "relayout", Qt::QueuedConnection);
+        return;
+    }
+
+    const int count = d.heights.count();
+    if (!count)
+        return;
+
+    const QRect bounds = event->rect();
+    const int height = viewport()->height();
+    const int m = margin();
+
+    // collect the rows that intersect the exposed area; rows that have not
+    // been measured yet are laid out here and nowhere else
+    bool measured = false;
+    QList<QPair<int, QRect> > rows;
+    if (d.bottom) {
+        int bottom = height - m;
+        for (int row = count - 1; row >= 0 && bottom > bounds.top(); --row) {
+            if (isFiltered(row))
+                continue;
+            measured |= d.heights.at(row) < 0;
+            const int h = rowHeight(row);
+            const QRect rect(m, bottom - h, d.width, h);
+            if (rect.intersects(bounds))
+                rows.prepend(qMakePair(row, rect));
+            bottom -= h;
+        }
+    } else {
+        const int value = verticalScrollBar()->value();
+        int row = qMax(0, rowAt(QPoint(0, bounds.top())));
+        int top = m + rowTop(row) - value;
+        for (; row < count && top <= bounds.bottom(); ++row) {
+            if (isFiltered(row))
+                continue;
+            measured |= d.heights.at(row) < 0;
+            const int h = rowHeight(row);
+            rows.append(qMakePair(row, QRect(m, top, d.width, h)));
+            top += h;
+        }
+    }
+
+    if (rows.isEmpty())
+        return;
+
+    QPainter painter(viewport());
+
+    // lowlight everything from the top down to the lowlight row
+    const int lowlight = d.model->lowlight();
+    if (lowlight >= rows.first().first) {
+        QRect br = viewport()->rect();
+        if (rowTop(rows.first().first) == 0)
+            br.setTop(rows.first().second.top() - m);
+        else
+            br.setTop(-2);
+        if (lowlight <= rows.last().first) {
+            // filtered rows leave gaps in the painted rows
+            int i = rows.count() - 1;
+            while (i > 0 && rows.at(i).first > lowlight)
+                --i;
+            br.setBottom(rows.at(i).second.bottom());
+        }
+        br.adjust(-1, 0, 1, 2);
+        drawFrame(&painter, d.lowlightFrame, br);
+    }
+
+    const QList<int> highlights = d.model->highlights();
+    for (int i = 0; i < rows.count(); ++i) {
+        const int row = rows.at(i).first;
+        if (std::binary_search(highlights.constBegin(), highlights.constEnd(), row))
+            drawFrame(&painter, d.highlightFrame, rows.at(i).second.adjusted(-m - 1, 0, m + 1, 2));
+        if (row == d.current) {
+            QColor color = palette().color(QPalette::Highlight);
+            color.setAlpha(64);
+            painter.fillRect(rows.at(i).second.adjusted(-m, 0, m, 0), color);
+        }
+    }
+
+    QAbstractTextDocumentLayout::PaintContext context;
+    context.palette = palette();
+    for (int i = 0; i < rows.count(); ++i) {
+        const QRect& rect = rows.at(i).second;
+        context.clip = QRectF(bounds.translated(-rect.topLeft()));
+        painter.save();
+        painter.translate(rect.topLeft());
+        rowDocument(rows.at(i).first)->documentLayout()->draw(&painter, context);
+        painter.restore();
+    }
+
+    for (int i = 0; i < rows.count(); ++i) {
+        if (rows.at(i).first == d.marker && d.marker > 0) {
+            const QRect& rect = rows.at(i).second;
+            painter.setBrush(Qt::NoBrush);
+            painter.setPen(QPen(palette().color(QPalette::Mid), 1, Qt::DashLine));
+            QLine line(rect.topLeft(), rect.topRight());
+            line.translate(0, -2);
+            painter.drawLine(line);
+            break;
+        }
+    }
+
+    // the scrollbar cannot be touched while painting
+    if (measured)
+        QMetaObject::invokeMethod(this, "updateScrollBar", Qt::QueuedConnection);
+}
+
+void MessageView::resizeEvent(QResizeEvent* event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+
+    const int width = qMax(0, viewport()->width() - 2 * margin());
+    if (d.width != width) {
+        // keep the cached layouts, they are re-wrapped lazily in rowDocument()
+        d.width = width;
+        d.heights.fill(-1);
+        d.valid = 0;
+    }
+    updateScrollBar();
+}
+
+void MessageView::scrollContentsBy(int dx, int dy)
+{
+    Q_UNUSED(dx);
+    d.bottom = isAtBottom();
+    viewport()->scroll(0, dy);
+}
+
+void MessageView::relayout()
+{
+    d.layouts.clear();
+    d.estimate = qCeil(fontMetrics().lineSpacing() * 1.25);
+    d.width = qMax(0, viewport()->width() - 2 * margin());
+    d.css = d.document ? d.document->styleSheet() : QString();
+    d.timeStampFormat = d.document ? d.document->timeStampFormat() : QString();
+    d.heights.fill(-1, d.model ? d.model->count() : 0);
+    d.tops.resize(d.heights.count() + 1);
+    d.valid = 0;
+    refilter();
+    updateScrollBar();
+    viewport()->update();
+}
+
+void MessageView::updateScrollBar()
+{
+    QScrollBar* bar = verticalScrollBar();
+    const int total = rowTop(d.heights.count()) + 2 * margin();
+    bar->setSingleStep(fontMetrics().lineSpacing());
+    bar->setPageStep(viewport()->height());
+    bar->setRange(0, qMax(0, total - viewport()->height()));
+    if (d.bottom)
+        bar->setValue(bar->maximum());
+}
+
+void MessageView::onRowsInserted(const QModelIndex& parent, int first, int last)
+{
+    Q_UNUSED(parent);
+    d.heights.insert(first, last - first + 1, -1);
+    d.tops.resize(d.heights.count() + 1);
+    if (!d.filter.isEmpty()) {
+        d.hidden.insert(first, last - first + 1, false);
+        for (int row = first; row <= last; ++row)
+            d.hidden[row] = !matches(row);
+    }
+    d.valid = qMin(d.valid, first + 1);
+    updateScrollBar();
+    viewport()->update();
+}
+
+void MessageView::onRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last)
+{
+    Q_UNUSED(parent);
+    d.removed = rowTop(last + 1) - rowTop(first);
+}
+
+void MessageView::onRowsRemoved(const QModelIndex& parent, int first, int last)
+{
+    Q_UNUSED(parent);
+    const int count = last - first + 1;
+    d.heights.remove(first, count);
+    d.tops.resize(d.heights.count() + 1);
+    if (!d.hidden.isEmpty())
+        d.hidden.remove(first, count);
+    d.valid = qMin(d.valid, first + 1);
+
+    if (d.marker > last)
+        d.marker -= count;
+    else if (d.marker >= first)
+        d.marker = -1;
+    if (d.current > last)
+        d.current -= count;
+    else if (d.current >= first)
+        d.current = -1;
+
+    // keep the content in place while old rows are being trimmed from the top
+    QScrollBar* bar = verticalScrollBar();
+    const int value = bar->value();
+    updateScrollBar();
+    if (!d.bottom && first == 0)
+        bar->setValue(value - d.removed);
+    viewport()->update();
+}
+
+void MessageView::onDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight)
+{
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+        if (row < d.heights.count()) {
+            d.layouts.remove(d.model->offset() + row);
+            d.heights[row] = -1;
+            if (row < d.hidden.count())
+                d.hidden[row] = !matches(row);
+        }
+    }
+    d.valid = qMin(d.valid, topLeft.row() + 1);
+    updateScrollBar();
+    viewport()->update();
+}
+
+void MessageView::onModelReset()
+{
+    d.marker = -1;
+    d.current = -1;
+    relayout();
+}
+
+void MessageView::onCopyTriggered()
+{
+    QAction* action = qobject_cast<QAction*>(sender());
+    if (action)
+        QApplication::clipboard()->setText(action->data().toString());
+}
+
+void MessageView::onWhoisTriggered()
+{
+    QAction* action = qobject_cast<QAction*>(sender());
+    if (action && buffer()) {
+        IrcCommand* command = IrcCommand::createWhois(action->data().toString());
+        buffer()->sendCommand(command);
+    }
+}
+
+void MessageView::onQueryTriggered()
+{
+    QAction* action = qobject_cast<QAction*>(sender());
+    if (action)
+        emit queried(action->data().toString());
+}
+
+void MessageView::onJoinTriggered()
+{
+    QAction* action = qobject_cast<QAction*>(sender());
+    if (action)
+        emit joined(action->data().toString());
+}
+
+int MessageView::margin() const
+{
+    if (d.document)
+        return qCeil(d.document->documentMargin());
+    return 0;
+}
+
+int MessageView::rowTop(int row) const
+{
+    if (d.valid == 0) {
+        d.tops[0] = 0;
+        d.valid = 1;
+    }
+    while (d.valid <= row) {
+        const int height = isFiltered(d.valid - 1) ? 0 : d.heights.at(d.valid - 1);
+        d.tops[d.valid] = d.tops.at(d.valid - 1) + (height < 0 ? d.estimate : height);
+        ++d.valid;
+    }
+    return d.tops.at(row);
+}
+
+int MessageView::rowHeight(int row) const
+{
+    if (isFiltered(row))
+        return 0;
+    int height = d.heights.at(row);
+    if (height < 0) {
+        height = qCeil(rowDocument(row)->size().height());
+        if (height != d.estimate)
+            d.valid = qMin(d.valid, row + 1);
+        d.heights[row] = height;
+    }
+    return height;
+}
+
+QTextDocument* MessageView::rowDocument(int row) const
+{
+    const int key = d.model->offset() + row;
+    QTextDocument* doc = d.layouts.object(key);
+    if (!doc) {
+        const QModelIndex index = d.model->index(row);
+
+        doc = new QTextDocument;
+        doc->setUndoRedoEnabled(false);
+        doc->setDocumentMargin(0);
+        doc->setDefaultFont(font());
+        doc->setDefaultStyleSheet(d.css);
+        doc->setHtml(index.data().toString());
+
+        QTextBlockFormat format;
+        format.setLineHeight(125, QTextBlockFormat::ProportionalHeight);
+        format.setAlignment(Qt::Alignment(index.data(Qt::TextAlignmentRole).toInt()));
+        QTextCursor cursor(doc);
+        cursor.select(QTextCursor::Document);
+        cursor.mergeBlockFormat(format);
+
+        doc->setTextWidth(d.width);
+        d.layouts.insert(key, doc);
+    } else if (!qFuzzyCompare(doc->textWidth(), qreal(d.width))) {
+        doc->setTextWidth(d.width);
+    }
+    return doc;
+}
+
+void MessageView::drawFrame(QPainter* painter, TextFrame* frame, const QRect& rect)
+{
+    painter->translate(rect.topLeft());
+    frame->setGeometry(rect);
+    frame->render(painter);
+    painter->translate(-rect.topLeft());
+}
+
+bool MessageView::matches(int row) const
+{
+    return d.filter.matches(d.model->message(row), d.model->isHighlighted(row));
+}
+
+// rows are filtered in one pass over the messages, without formatting or
+// laying them out; a growing filter only re-checks the rows still shown
+void MessageView::refilter(bool narrower)
+{
+    const int count = d.model ? d.model->count() : 0;
+    if (d.filter.isEmpty() || !count) {
+        d.hidden.clear();
+        return;
+    }
+    if (!narrower || d.hidden.count() != count)
+        d.hidden.fill(false, count);
+    for (int row = 0; row < count; ++row) {
+        if (!narrower || !d.hidden.at(row))
+            d.hidden[row] = !matches(row);
+    }
+}
@@ -0,0 +1,148 @@
+/*
+  Copyright (C) 2008-2016 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MESSAGEVIEW_H
+#define MESSAGEVIEW_H
+
+#include <QAbstractScrollArea>
+#include <QModelIndex>
+#include <QPointer>
+#include <QVector>
+#include <QCache>
+#include "baseglobal.h"
+#include "messagequery.h"
+
+class IrcBuffer;
+class TextFrame;
+class MessageModel;
+class TextDocument;
+class QTextDocument;
+
+class BASE_EXPORT MessageView : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+public:
+    explicit MessageView(QWidget* parent = 0);
+    ~MessageView();
+
+    IrcBuffer* buffer() const;
+
+    TextDocument* document() const;
+    void setDocument(TextDocument* document);
+
+    QWidget* buddy() const;
+    void setBuddy(QWidget* buddy);
+
+    bool isAtTop() const;
+    bool isAtBottom() const;
+
+    int rowAt(const QPoint& pos) const;
+    QRect rowRect(int row) const;
+    QString anchorAt(const QPoint& pos) const;
+
+    int currentRow() const;
+    void setCurrentRow(int row);
+
+    MessageQuery filter() const;
+    void setFilter(const MessageQuery& filter);
+    bool isFiltered(int row) const;
+    int firstRow() const;
+
+    QMenu* createContextMenu(const QPoint& pos);
+
+public slots:
+    void clear();
+    void scrollToTop();
+    void scrollToBottom();
+    void scrollToNextPage();
+    void scrollToPreviousPage();
+    void scrollToRow(int row);
+
+signals:
+    void joined(const QString& channel);
+    void queried(const QString& user);
+    void documentChanged(TextDocument* document);
+
+protected:
+    void changeEvent(QEvent* event);
+    void keyPressEvent(QKeyEvent* event);
+    void mouseMoveEvent(QMouseEvent* event);
+    void mousePressEvent(QMouseEvent* event);
+    void paintEvent(QPaintEvent* event);
+    void resizeEvent(QResizeEvent* event);
+    void scrollContentsBy(int dx, int dy);
+
+private slots:
+    void relayout();
+    void updateScrollBar();
+
+    void onRowsInserted(const QModelIndex& parent, int first, int last);
+    void onRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last);
+    void onRowsRemoved(const QModelIndex& parent, int first, int last);
+    void onDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
+    void onModelReset();
+
+    void onCopyTriggered();
+    void onWhoisTriggered();
+    void onQueryTriggered();
+    void onJoinTriggered();
+
+private:
+    int margin() const;
+    int rowTop(int row) const;
+    int rowHeight(int row) const;
+    QTextDocument* rowDocument(int row) const;
+    bool matches(int row) const;
+    void refilter(bool narrower = false);
+    void drawFrame(QPainter* painter, TextFrame* frame, const QRect& rect);
+
+    struct Private {
+        bool bottom;
+        int marker;
+        int current;
+        int width;
+        int removed;
+        int estimate;
+        QWidget* bud;
+        QString css;
+        QString timeStampFormat;
+        MessageQuery filter;
+        QVector<bool> hidden;
+        QPointer<MessageModel> model;
+        QPointer<TextDocument> document;
+        TextFrame* lowlightFrame;
+        TextFrame* highlightFrame;
+        mutable int valid;
+        mutable QVector<int> tops;
+        mutable QVector<int> heights;
+        mutable QCache<int, QTextDocument> layouts;
+    } d;
+};
+
+#endif // MESSAGEVIEW_H
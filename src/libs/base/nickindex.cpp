@@ -0,0 +1,140 @@
+/*
+  Copyright (C) 2008-2016 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "nickindex.h"
+#include <IrcUserModel>
+#include <IrcChannel>
+#include <IrcUser>
+
+// one index per channel, shared by every formatter, document and title
+// bar showing it and kept up to date one join, part or nick at a time
+
+NickIndex* NickIndex::acquire(IrcChannel* channel)
+{
+    NickIndex* index = channel->findChild<NickIndex*>(QString(), Qt::FindDirectChildrenOnly);
+    if (!index)
+        index = new NickIndex(channel);
+    ++index->d.refs;
+    return index;
+}
+
+void NickIndex::release()
+{
+    if (--d.refs <= 0)
+        delete this;
+}
+
+NickIndex::NickIndex(IrcChannel* channel) : QObject(channel)
+{
+    d.refs = 0;
+    d.version = 0;
+    d.channel = channel;
+
+    // unsorted, the index does not care about the order
+    d.model = new IrcUserModel(this);
+    connect(d.model, SIGNAL(modelReset()), this, SLOT(reset()));
+    connect(d.model, SIGNAL(added(IrcUser*)), this, SLOT(add(IrcUser*)));
+    connect(d.model, SIGNAL(removed(IrcUser*)), this, SLOT(remove(IrcUser*)));
+    d.model->setChannel(channel);
+    reset();
+}
+
+IrcChannel* NickIndex::channel() const
+{
+    return d.channel;
+}
+
+// linked here on the gui thread, a burst of joins and parts links once
+// and the copies the formatting threads get are ready to match
+const NickMatcher& NickIndex::matcher()
+{
+    if (!d.matcher.isLinked())
+        d.matcher.link();
+    return d.matcher;
+}
+
+int NickIndex::count() const
+{
+    return d.users.count();
+}
+
+// bumped on every change, formatted lines depend on the nicks they link
+int NickIndex::version() const
+{
+    return d.version;
+}
+
+void NickIndex::reset()
+{
+    // users that are gone no longer match in rename()
+    d.users.clear();
+
+    foreach (IrcUser* user, d.model->users()) {
+        d.users.insert(user, user->name());
+        connect(user, SIGNAL(nameChanged(QString)), this, SLOT(rename(QString)), Qt::UniqueConnection);
+    }
+    d.matcher.setNames(d.model->names());
+    ++d.version;
+    emit changed();
+}
+
+void NickIndex::add(IrcUser* user)
+{
+    if (d.users.contains(user))
+        return;
+
+    d.users.insert(user, user->name());
+    connect(user, SIGNAL(nameChanged(QString)), this, SLOT(rename(QString)), Qt::UniqueConnection);
+    d.matcher.addName(user->name());
+    ++d.version;
+    emit changed();
+}
+
+void NickIndex::remove(IrcUser* user)
+{
+    if (!d.users.contains(user))
+        return;
+
+    disconnect(user, SIGNAL(nameChanged(QString)), this, SLOT(rename(QString)));
+    d.matcher.removeName(d.users.take(user));
+    ++d.version;
+    emit changed();
+}
+
+void NickIndex::rename(const QString& name)
+{
+    IrcUser* user = qobject_cast<IrcUser*>(sender());
+    if (!user || !d.users.contains(user))
+        return;
+
+    d.matcher.removeName(d.users.value(user));
+    d.matcher.addName(name);
+    d.users.insert(user, name);
+    ++d.version;
+    emit changed();
+}
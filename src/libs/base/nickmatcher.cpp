@@ -0,0 +1,190 @@
+/*
+  Copyright (C) 2008-2016 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "nickmatcher.h"
+
+// an aho-corasick automaton over the nicks of a channel, so that a line
+// is scanned once no matter how many users there are; the owner links
+// it once after the nicks changed and before handing out copies, which
+// are then only ever read
+
+NickMatcher::NickMatcher()
+{
+    d.removed = 0;
+    d.linked = true;
+    d.nodes.resize(1);
+}
+
+bool NickMatcher::isEmpty() const
+{
+    return d.names.isEmpty();
+}
+
+void NickMatcher::setNames(const QStringList& names)
+{
+    QSet<QString> set;
+    foreach (const QString& name, names) {
+        if (!name.isEmpty())
+            set.insert(name);
+    }
+
+    // user lists change by a nick or two at a time, only touch those
+    const QSet<QString> added = QSet<QString>(set).subtract(d.names);
+    const QSet<QString> removed = QSet<QString>(d.names).subtract(set);
+    if (added.isEmpty() && removed.isEmpty())
+        return;
+
+    d.names = set;
+    d.removed += removed.count();
+    if (d.removed > d.names.count()) {
+        // more dead branches than live ones
+        rebuild();
+        return;
+    }
+
+    foreach (const QString& name, removed)
+        remove(name);
+    foreach (const QString& name, added)
+        insert(name);
+    d.linked = false;
+}
+
+void NickMatcher::addName(const QString& name)
+{
+    if (name.isEmpty() || d.names.contains(name))
+        return;
+
+    d.names.insert(name);
+    insert(name);
+    d.linked = false;
+}
+
+void NickMatcher::removeName(const QString& name)
+{
+    if (!d.names.remove(name))
+        return;
+
+    if (++d.removed > d.names.count()) {
+        rebuild();
+    } else {
+        remove(name);
+        d.linked = false;
+    }
+}
+
+void NickMatcher::match(const QString& text, int from, int to, QList<Match>* matches) const
+{
+    if (d.names.isEmpty() || !d.linked)
+        return;
+
+    int state = 0;
+    for (int i = from; i < to; ++i) {
+        const ushort c = text.at(i).unicode();
+        while (state && !d.nodes.at(state).next.contains(c))
+            state = d.nodes.at(state).fail;
+        state = d.nodes.at(state).next.value(c, 0);
+
+        const Node& node = d.nodes.at(state);
+        for (int out = node.length ? state : node.output; out; out = d.nodes.at(out).output) {
+            Match match;
+            match.length = d.nodes.at(out).length;
+            match.start = i - match.length + 1;
+            matches->append(match);
+        }
+    }
+}
+
+void NickMatcher::insert(const QString& name)
+{
+    int state = 0;
+    foreach (const QChar& c, name) {
+        int next = d.nodes.at(state).next.value(c.unicode(), 0);
+        if (!next) {
+            next = d.nodes.count();
+            d.nodes.append(Node());
+            d.nodes[state].next.insert(c.unicode(), next);
+        }
+        state = next;
+    }
+    d.nodes[state].length = name.length();
+}
+
+void NickMatcher::remove(const QString& name)
+{
+    int state = 0;
+    foreach (const QChar& c, name) {
+        state = d.nodes.at(state).next.value(c.unicode(), 0);
+        if (!state)
+            return;
+    }
+    d.nodes[state].length = 0;
+}
+
+bool NickMatcher::isLinked() const
+{
+    return d.linked;
+}
+
+// recomputes the failure and output links breadth first
+void NickMatcher::link()
+{
+    QVector<int> queue;
+    queue.reserve(d.nodes.count());
+    queue += 0;
+
+    for (int i = 0; i < queue.count(); ++i) {
+        const int state = queue.at(i);
+        const QHash<ushort, int> next = d.nodes.at(state).next;
+        QHash<ushort, int>::const_iterator it;
+        for (it = next.constBegin(); it != next.constEnd(); ++it) {
+            const int child = it.value();
+            int fail = d.nodes.at(state).fail;
+            while (fail && !d.nodes.at(fail).next.contains(it.key()))
+                fail = d.nodes.at(fail).fail;
+            fail = d.nodes.at(fail).next.value(it.key(), 0);
+            if (fail == child)
+                fail = 0;
+
+            Node& node = d.nodes[child];
+            node.fail = fail;
+            node.output = d.nodes.at(fail).length ? fail : d.nodes.at(fail).output;
+            queue += child;
+        }
+    }
+    d.linked = true;
+}
+
+void NickMatcher::rebuild()
+{
+    d.removed = 0;
+    d.nodes.clear();
+    d.nodes.resize(1);
+    foreach (const QString& name, d.names)
+        insert(name);
+    d.linked = false;
+}
@@ -0,0 +1,81 @@
+/*
+  Copyright (C) 2008-2016 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef NICKMATCHER_H
+#define NICKMATCHER_H
+
+#include <QSet>
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include <QString>
+#include <QStringList>
+#include "baseglobal.h"
+
+class BASE_EXPORT NickMatcher
+{
+public:
+    NickMatcher();
+
+    bool isEmpty() const;
+    void setNames(const QStringList& names);
+    void addName(const QString& name);
+    void removeName(const QString& name);
+
+    bool isLinked() const;
+    void link();
+
+    struct Match {
+        int start;
+        int length;
+    };
+
+    void match(const QString& text, int from, int to, QList<Match>* matches) const;
+
+private:
+    struct Node {
+        Node() : fail(0), output(0), length(0) { }
+        QHash<ushort, int> next;
+        int fail;
+        int output;
+        int length;
+    };
+
+    void insert(const QString& name);
+    void remove(const QString& name);
+    void rebuild();
+
+    struct Private {
+        int removed;
+        bool linked;
+        QSet<QString> names;
+        QVector<Node> nodes;
+    } d;
+};
+
+#endif // NICKMATCHER_H
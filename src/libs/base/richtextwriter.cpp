@@ -0,0 +1,260 @@
+/*
+  Copyright (C) 2008-2016 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "richtextwriter.h"
+#include <QTextDocument>
+#include <QTextCursor>
+#include <QTextBlock>
+#include <QSet>
+
+// the subset of html the message formatters produce, anything else
+// is left to QTextCursor::insertHtml()
+static bool isSupported(const QString& tag)
+{
+    static QSet<QString> tags = QSet<QString>() << "span" << "a" << "b" << "i" << "u" << "s";
+    return tags.contains(tag);
+}
+
+RichTextWriter::RichTextWriter(QTextDocument* document)
+{
+    d.document = document;
+}
+
+bool RichTextWriter::write(QTextCursor& cursor, const QString& html)
+{
+    QList<Run> runs;
+    QList<Tag> tags;
+    Style current = style(tags);
+    QString text;
+    bool space = true;
+
+    // parse everything before touching the cursor, so that the
+    // caller can still fall back to the html parser
+    const int length = html.length();
+    for (int i = 0; i < length; ++i) {
+        const QChar c = html.at(i);
+        if (c == QLatin1Char('<')) {
+            const int end = html.indexOf(QLatin1Char('>'), i);
+            if (end == -1)
+                return false;
+
+            if (!text.isEmpty()) {
+                Run run;
+                run.text = text;
+                run.format = current.format;
+                runs += run;
+                text.clear();
+            }
+
+            if (html.at(i + 1) == QLatin1Char('/')) {
+                const QString name = html.mid(i + 2, end - i - 2).trimmed().toLower();
+                if (tags.isEmpty() || tags.last().name != name)
+                    return false;
+                tags.removeLast();
+            } else {
+                Tag tag;
+                if (!parseTag(html.mid(i + 1, end - i - 1), &tag))
+                    return false;
+                tags += tag;
+            }
+
+            current = style(tags);
+            for (int t = tags.count() - 1; t >= 0; --t) {
+                if (tags.at(t).name == QLatin1String("a")) {
+                    current.format.setAnchor(true);
+                    current.format.setAnchorHref(tags.at(t).href);
+                    break;
+                }
+            }
+            i = end;
+        } else if (c == QLatin1Char('&')) {
+            const int end = html.indexOf(QLatin1Char(';'), i);
+            QChar ch;
+            if (end == -1 || end - i > 10 || !parseEntity(html.mid(i + 1, end - i - 1), &ch))
+                return false;
+            text += ch;
+            space = false;
+            i = end;
+        } else if (c.isSpace() && !current.pre) {
+            // collapse white space like the html parser does
+            if (!space)
+                text += QLatin1Char(' ');
+            space = true;
+        } else {
+            text += c;
+            space = false;
+        }
+    }
+
+    if (!tags.isEmpty())
+        return false;
+
+    if (!text.isEmpty()) {
+        Run run;
+        run.text = text;
+        run.format = current.format;
+        runs += run;
+    }
+
+    foreach (const Run& run, runs)
+        cursor.insertText(run.text, run.format);
+    return true;
+}
+
+void RichTextWriter::invalidate()
+{
+    d.styles.clear();
+}
+
+bool RichTextWriter::parseTag(const QString& content, Tag* tag)
+{
+    const int length = content.length();
+    int i = 0;
+    while (i < length && !content.at(i).isSpace())
+        ++i;
+    tag->name = content.left(i).toLower();
+    if (!isSupported(tag->name))
+        return false;
+
+    tag->key = QLatin1Char('<') + tag->name;
+    while (i < length) {
+        if (content.at(i).isSpace()) {
+            ++i;
+            continue;
+        }
+
+        const int eq = content.indexOf(QLatin1Char('='), i);
+        if (eq == -1 || eq + 1 >= length)
+            return false;
+        const QString name = content.mid(i, eq - i).trimmed().toLower();
+
+        QString value;
+        const QChar quote = content.at(eq + 1);
+        if (quote == QLatin1Char('\'') || quote == QLatin1Char('"')) {
+            const int end = content.indexOf(quote, eq + 2);
+            if (end == -1)
+                return false;
+            value = content.mid(eq + 2, end - eq - 2);
+            i = end + 1;
+        } else {
+            int end = eq + 1;
+            while (end < length && !content.at(end).isSpace())
+                ++end;
+            value = content.mid(eq + 1, end - eq - 1);
+            i = end;
+        }
+
+        if (name == QLatin1String("href")) {
+            QString href;
+            for (int v = 0; v < value.length(); ++v) {
+                QChar ch = value.at(v);
+                if (ch == QLatin1Char('&')) {
+                    const int end = value.indexOf(QLatin1Char(';'), v);
+                    if (end == -1 || !parseEntity(value.mid(v + 1, end - v - 1), &ch))
+                        return false;
+                    v = end;
+                }
+                href += ch;
+            }
+            tag->href = href;
+        } else {
+            if (value.contains(QLatin1Char('\'')))
+                return false;
+            tag->key += QLatin1Char(' ') + name + QLatin1String("='") + value + QLatin1Char('\'');
+        }
+    }
+    tag->key += QLatin1Char('>');
+    return true;
+}
+
+bool RichTextWriter::parseEntity(const QString& entity, QChar* ch)
+{
+    if (entity == QLatin1String("lt"))
+        *ch = QLatin1Char('<');
+    else if (entity == QLatin1String("gt"))
+        *ch = QLatin1Char('>');
+    else if (entity == QLatin1String("amp"))
+        *ch = QLatin1Char('&');
+    else if (entity == QLatin1String("quot"))
+        *ch = QLatin1Char('"');
+    else if (entity == QLatin1String("apos"))
+        *ch = QLatin1Char('\'');
+    else if (entity == QLatin1String("nbsp"))
+        *ch = QChar(QChar::Nbsp);
+    else if (entity.startsWith(QLatin1Char('#'))) {
+        bool ok = false;
+        uint code = 0;
+        if (entity.startsWith(QLatin1String("#x"), Qt::CaseInsensitive))
+            code = entity.mid(2).toUInt(&ok, 16);
+        else
+            code = entity.mid(1).toUInt(&ok);
+        // surrogate pairs are left to the html parser
+        if (!ok || code > 0xffff)
+            return false;
+        *ch = QChar(code);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// resolves the char format of a tag stack by letting the html parser
+// apply the document stylesheet once, the result is reused for every
+// other line with the same markup
+RichTextWriter::Style RichTextWriter::style(const QList<Tag>& tags)
+{
+    QString key;
+    foreach (const Tag& tag, tags)
+        key += tag.key;
+
+    QHash<QString, Style>::const_iterator it = d.styles.constFind(key);
+    if (it != d.styles.constEnd())
+        return it.value();
+
+    QString open, close;
+    foreach (const Tag& tag, tags) {
+        QString probe = tag.key;
+        if (tag.name == QLatin1String("a"))
+            probe.insert(probe.length() - 1, QLatin1String(" href='#'"));
+        open += probe;
+        close.prepend(QLatin1String("</") + tag.name + QLatin1Char('>'));
+    }
+
+    QTextDocument doc;
+    doc.setDefaultFont(d.document->defaultFont());
+    doc.setDefaultStyleSheet(d.document->defaultStyleSheet());
+    QTextCursor cursor(&doc);
+    cursor.insertHtml(open + QLatin1String("x  x") + close);
+
+    Style style;
+    style.pre = doc.firstBlock().text().contains(QLatin1String("  "));
+    cursor.setPosition(1);
+    style.format = cursor.charFormat();
+    d.styles.insert(key, style);
+    return style;
+}
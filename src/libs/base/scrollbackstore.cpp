@@ -0,0 +1,206 @@
+/*
+  Copyright (C) 2008-2016 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "scrollbackstore.h"
+#include <QTemporaryFile>
+#include <QDataStream>
+#include <QDir>
+
+// the lines of a buffer are appended to a single file as length-prefixed
+// records, indexed by their offsets in memory; the file is read back with
+// a seek per line instead of being mapped, paging back is rare and a map
+// per sealed segment would hold a descriptor open per segment and buffer
+static const int CompactLines = 4096;
+
+// the copy buffer used when compacting
+static const qint64 ChunkSize = 64 * 1024;
+
+ScrollbackStore::ScrollbackStore(QObject* parent) : QObject(parent)
+{
+    d.first = 0;
+    d.count = 0;
+    d.limit = 100000;
+    d.base = 0;
+    d.end = 0;
+    d.file = 0;
+}
+
+ScrollbackStore::~ScrollbackStore()
+{
+    delete d.file;
+}
+
+int ScrollbackStore::first() const
+{
+    return d.first;
+}
+
+int ScrollbackStore::count() const
+{
+    return d.count;
+}
+
+int ScrollbackStore::limit() const
+{
+    return d.limit;
+}
+
+void ScrollbackStore::setLimit(int limit)
+{
+    limit = qMax(0, limit);
+    if (d.limit != limit) {
+        d.limit = limit;
+        trim();
+    }
+}
+
+// lines are stored in order, a document cleared ahead of the others
+// leaves a gap of lines that are never stored
+void ScrollbackStore::append(int index, const MessageData& data)
+{
+    if (index < d.count)
+        return;
+    for (; d.count < index; ++d.count)
+        d.offsets += -1;
+
+    if (d.limit > 0) {
+        QByteArray record;
+        QDataStream out(&record, QIODevice::WriteOnly);
+        out << data;
+
+        // the line is accounted for even if the write fails, so that the
+        // indexes of the following lines stay valid
+        const qint64 offset = d.end;
+        d.offsets += write(record) ? offset : -1;
+    } else {
+        d.offsets += -1;
+    }
+    ++d.count;
+    trim();
+}
+
+MessageData ScrollbackStore::at(int index) const
+{
+    MessageData data;
+    if (index < d.first || index >= d.count || !d.file)
+        return data;
+
+    const qint64 offset = d.offsets.value(index - d.base, -1);
+    if (offset < 0 || !d.file->seek(offset))
+        return data;
+
+    QByteArray record;
+    QDataStream in(d.file);
+    in >> record;
+    if (in.status() == QDataStream::Ok && !record.isEmpty()) {
+        QDataStream stream(record);
+        stream >> data;
+    }
+    return data;
+}
+
+// drops every line, the following ones keep counting from where it was
+void ScrollbackStore::clear()
+{
+    d.first = d.count;
+    compact();
+}
+
+// a failed or partial write is overwritten by the next record
+bool ScrollbackStore::write(const QByteArray& record)
+{
+    if (!d.file) {
+        d.file = new QTemporaryFile(QDir::temp().filePath("communi-XXXXXX.log"));
+        if (!d.file->open()) {
+            delete d.file;
+            d.file = 0;
+            return false;
+        }
+    }
+
+    QByteArray bytes;
+    QDataStream out(&bytes, QIODevice::WriteOnly);
+    out << record;
+
+    if (!d.file->seek(d.end) || d.file->write(bytes) != bytes.size())
+        return false;
+    d.end += bytes.size();
+    return true;
+}
+
+// lines behind the limit are dropped in bulk, once there are at least as
+// many of them as there are lines left, which bounds the file and index
+void ScrollbackStore::trim()
+{
+    d.first = qMax(d.first, d.count - d.limit);
+    const int dead = d.first - d.base;
+    if (dead >= CompactLines && dead >= d.count - d.first)
+        compact();
+}
+
+// copies the lines still in use to a new file and drops the old one
+void ScrollbackStore::compact()
+{
+    QVector<qint64> offsets = d.offsets.mid(d.first - d.base);
+
+    qint64 start = d.end;
+    foreach (qint64 offset, offsets) {
+        if (offset >= 0) {
+            start = offset;
+            break;
+        }
+    }
+
+    if (start < d.end) {
+        QTemporaryFile* file = new QTemporaryFile(QDir::temp().filePath("communi-XXXXXX.log"));
+        bool ok = file->open() && d.file->seek(start);
+        for (qint64 pos = start; ok && pos < d.end; ) {
+            const QByteArray chunk = d.file->read(qMin(ChunkSize, d.end - pos));
+            ok = !chunk.isEmpty() && file->write(chunk) == chunk.size();
+            pos += chunk.size();
+        }
+        if (ok) {
+            delete d.file;
+            d.file = file;
+        } else {
+            // keep the old file, only the index of the dead lines goes
+            delete file;
+            start = 0;
+        }
+    } else if (d.file && !d.file->resize(0)) {
+        start = 0;
+    }
+
+    for (int i = 0; i < offsets.count(); ++i) {
+        if (offsets.at(i) >= 0)
+            offsets[i] -= start;
+    }
+    d.end -= start;
+    d.offsets = offsets;
+    d.base = d.first;
+}
@@ -0,0 +1,285 @@
+/*
+  Copyright (C) 2008-2016 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "searchindex.h"
+#include "messagedata.h"
+#include <algorithm>
+#include <IrcBuffer>
+#include <QSet>
+
+// lines are numbered in the order they arrive, so that every posting
+// list stays sorted and the oldest lines drop off the front once full;
+// the text is kept as utf-8 for the hits, lines much older than the
+// scrollback of their buffer could not be opened anyway
+static const int DefaultCapacity = 100000;
+
+// the shortest token worth indexing, and how many tokens the word
+// still being typed may expand to
+static const int MinimumLength = 2;
+static const int MaximumExpansion = 64;
+
+// candidates looked at per requested hit when ranking
+static const int RankFactor = 4;
+
+static bool shorterThan(const QVector<int>& one, const QVector<int>& another)
+{
+    return one.count() < another.count();
+}
+
+static bool scoreGreaterThan(const SearchIndex::Hit& one, const SearchIndex::Hit& another)
+{
+    return one.score > another.score;
+}
+
+static bool isSeparator(const QChar& c)
+{
+    return c.isSpace() || c.unicode() < 0x20;
+}
+
+SearchIndex::SearchIndex(QObject* parent) : QObject(parent)
+{
+    d.base = 0;
+    d.trimmed = 0;
+    d.capacity = DefaultCapacity;
+    d.nextBuffer = 0;
+}
+
+SearchIndex* SearchIndex::instance()
+{
+    static SearchIndex index;
+    return &index;
+}
+
+int SearchIndex::capacity() const
+{
+    return d.capacity;
+}
+
+void SearchIndex::setCapacity(int capacity)
+{
+    d.capacity = qMax(0, capacity);
+    trim();
+}
+
+int SearchIndex::count() const
+{
+    return d.entries.count();
+}
+
+int SearchIndex::tokenCount() const
+{
+    return d.postings.count();
+}
+
+// returns the number of the line, which identifies it in the documents
+// of the buffer, or -1 if it is not indexed
+int SearchIndex::add(IrcBuffer* buffer, const MessageData& data, const QString& text)
+{
+    if (!buffer || d.capacity <= 0 || text.isEmpty())
+        return -1;
+
+    const int number = d.base + d.entries.count();
+    Entry entry = { bufferId(buffer), data.msecs(), data.nick(), text.toUtf8() };
+    d.entries += entry;
+
+    QSet<QString> tokens;
+    foreach (const QString& token, tokenize(text))
+        tokens.insert(token);
+    if (!entry.nick.isEmpty())
+        tokens.insert(entry.nick.toLower());
+    foreach (const QString& token, tokens)
+        d.postings[token] += number;
+
+    trim();
+    return number;
+}
+
+QList<SearchIndex::Hit> SearchIndex::search(const QString& query, int limit) const
+{
+    QList<Hit> hits;
+    const QStringList terms = tokenize(query, false);
+    if (terms.isEmpty() || limit <= 0)
+        return hits;
+
+    // the last word may still be being typed
+    const bool typing = !isSeparator(query.at(query.length() - 1));
+
+    QList<QVector<int> > lists;
+    for (int i = 0; i < terms.count(); ++i) {
+        const QVector<int> ids = postings(terms.at(i), typing && i == terms.count() - 1);
+        if (ids.isEmpty())
+            return hits;
+        lists += ids;
+    }
+
+    // intersect starting from the rarest term
+    std::sort(lists.begin(), lists.end(), shorterThan);
+    QVector<int> matches = lists.first();
+    for (int i = 1; i < lists.count() && !matches.isEmpty(); ++i) {
+        const QVector<int>& other = lists.at(i);
+        QVector<int> common;
+        foreach (int id, matches) {
+            if (std::binary_search(other.constBegin(), other.constEnd(), id))
+                common += id;
+        }
+        matches = common;
+    }
+
+    // newest first, lines that contain the query as typed rank higher
+    const QString phrase = query.simplified();
+    for (int i = matches.count() - 1; i >= 0 && hits.count() < limit * RankFactor; --i) {
+        const int number = matches.at(i);
+        if (number < d.base)
+            break;
+        const Entry& entry = d.entries.at(number - d.base);
+        IrcBuffer* buffer = d.buffers.value(entry.buffer);
+        if (!buffer)
+            continue;
+        Hit hit;
+        hit.buffer = buffer;
+        hit.id = number;
+        hit.timestamp = entry.timestamp;
+        hit.nick = entry.nick;
+        hit.text = QString::fromUtf8(entry.text);
+        hit.score = hit.text.contains(phrase, Qt::CaseInsensitive) ? 1 : 0;
+        hits += hit;
+    }
+    std::stable_sort(hits.begin(), hits.end(), scoreGreaterThan);
+    return hits.mid(0, limit);
+}
+
+// whole words with surrounding punctuation stripped, plus their
+// alphanumeric parts, so that both "irc.example.com" and "example"
+// find a host name
+QStringList SearchIndex::tokenize(const QString& text, bool parts)
+{
+    QStringList tokens;
+    const QString lower = text.toLower();
+    const int length = lower.length();
+    int i = 0;
+    while (i < length) {
+        while (i < length && isSeparator(lower.at(i)))
+            ++i;
+        int start = i;
+        while (i < length && !isSeparator(lower.at(i)))
+            ++i;
+        int end = i;
+        while (start < end && !lower.at(start).isLetterOrNumber())
+            ++start;
+        while (end > start && !lower.at(end - 1).isLetterOrNumber())
+            --end;
+        if (end - start < MinimumLength)
+            continue;
+
+        tokens += lower.mid(start, end - start);
+        if (parts) {
+            int j = start;
+            while (j < end) {
+                while (j < end && !lower.at(j).isLetterOrNumber())
+                    ++j;
+                const int from = j;
+                while (j < end && lower.at(j).isLetterOrNumber())
+                    ++j;
+                if (j - from >= MinimumLength && j - from < end - start)
+                    tokens += lower.mid(from, j - from);
+            }
+        }
+    }
+    return tokens;
+}
+
+int SearchIndex::bufferId(IrcBuffer* buffer)
+{
+    int id = d.ids.value(buffer, -1);
+    if (id == -1) {
+        id = d.nextBuffer++;
+        d.buffers.insert(id, buffer);
+        d.ids.insert(buffer, id);
+        connect(buffer, SIGNAL(destroyed(QObject*)), this, SLOT(removeBuffer(QObject*)));
+    }
+    return id;
+}
+
+// the lines of a buffer that is gone are no longer found, their text
+// goes right away and the rest once they are trimmed
+void SearchIndex::removeBuffer(QObject* buffer)
+{
+    const int id = d.ids.take(static_cast<IrcBuffer*>(buffer));
+    d.buffers.remove(id);
+    for (int i = 0; i < d.entries.count(); ++i) {
+        if (d.entries.at(i).buffer == id) {
+            d.entries[i].text.clear();
+            d.entries[i].nick.clear();
+        }
+    }
+}
+
+QVector<int> SearchIndex::postings(const QString& term, bool prefix) const
+{
+    if (!prefix)
+        return d.postings.value(term);
+
+    QVector<int> ids;
+    int expanded = 0;
+    QMap<QString, QVector<int> >::const_iterator it = d.postings.lowerBound(term);
+    while (it != d.postings.constEnd() && it.key().startsWith(term) && expanded < MaximumExpansion) {
+        ids += it.value();
+        ++expanded;
+        ++it;
+    }
+    if (expanded > 1) {
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    }
+    return ids;
+}
+
+// drops the oldest lines beyond the capacity, and every now and then
+// the postings that point to them
+void SearchIndex::trim()
+{
+    while (d.entries.count() > d.capacity) {
+        d.entries.removeFirst();
+        ++d.base;
+    }
+
+    if (d.base - d.trimmed <= qMax(1, d.capacity / 2))
+        return;
+
+    QMap<QString, QVector<int> >::iterator it = d.postings.begin();
+    while (it != d.postings.end()) {
+        QVector<int>& ids = it.value();
+        QVector<int>::iterator end = std::lower_bound(ids.begin(), ids.end(), d.base);
+        ids.erase(ids.begin(), end);
+        if (ids.isEmpty())
+            it = d.postings.erase(it);
+        else
+            ++it;
+    }
+    d.trimmed = d.base;
+}
@@ -0,0 +1,102 @@
+/*
+  Copyright (C) 2008-2016 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <QMap>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QVector>
+#include <QString>
+#include <QPointer>
+#include <QStringList>
+#include "baseglobal.h"
+
+class IrcBuffer;
+class MessageData;
+
+class BASE_EXPORT SearchIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    static SearchIndex* instance();
+
+    int capacity() const;
+    void setCapacity(int capacity);
+
+    int count() const;
+    int tokenCount() const;
+
+    int add(IrcBuffer* buffer, const MessageData& data, const QString& text);
+
+    struct Hit {
+        QPointer<IrcBuffer> buffer;
+        int id;
+        qint64 timestamp;
+        QString nick;
+        QString text;
+        int score;
+    };
+
+    QList<Hit> search(const QString& query, int limit = 100) const;
+
+    static QStringList tokenize(const QString& text, bool parts = true);
+
+private slots:
+    void removeBuffer(QObject* buffer);
+
+private:
+    SearchIndex(QObject* parent = 0);
+
+    int bufferId(IrcBuffer* buffer);
+    QVector<int> postings(const QString& term, bool prefix) const;
+    void trim();
+
+    struct Entry {
+        int buffer;
+        qint64 timestamp;
+        QString nick;
+        QByteArray text;
+    };
+
+    struct Private {
+        int base;
+        int trimmed;
+        int capacity;
+        int nextBuffer;
+        QList<Entry> entries;
+        QMap<QString, QVector<int> > postings;
+        QHash<int, IrcBuffer*> buffers;
+        QHash<IrcBuffer*, int> ids;
+    } d;
+};
+
+#endif // SEARCHINDEX_H
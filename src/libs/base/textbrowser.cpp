@@ -28,6 +28,7 @@
 
 #include "textbrowser.h"
 #include "textdocument.h"
+#include "messageformatter.h"
 #include <QAbstractTextDocumentLayout>
 #include <QDesktopServices>
 #include <QStylePainter>
@@ -54,6 +55,7 @@ TextBrowser::TextBrowser(QWidget* parent) : QTextBrowser(parent)
     setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
 
     connect(this, SIGNAL(anchorClicked(QUrl)), this, SLOT(onAnchorClicked(QUrl)));
+    connect(verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(fetchMore()));
 }
 
 TextBrowser::~TextBrowser()
@@ -176,6 +178,13 @@ void TextBrowser::resizeEvent(QResizeEvent* event)
     QMetaObject::invokeMethod(this, "scrollToBottom", Qt::QueuedConnection);
 }
 
+void TextBrowser::changeEvent(QEvent* event)
+{
+    QTextBrowser::changeEvent(event);
+    if (event->type() == QEvent::LanguageChange)
+        MessageFormatter::retranslate();
+}
+
 bool TextBrowser::isAtTop() const
 {
     return verticalScrollBar()->value() <= verticalScrollBar()->minimum();
@@ -260,10 +269,11 @@ QMenu* TextBrowser::createContextMenu(const QPoint& pos)
 
 void TextBrowser::clear()
 {
-    QTextBrowser::clear();
+    // the document counts its lines before they are gone
     TextDocument* doc = document();
     if (doc)
         doc->reset();
+    QTextBrowser::clear();
 }
 
 void TextBrowser::resetZoom()
@@ -348,6 +358,20 @@ void TextBrowser::keepPosition(int delta)
         verticalScrollBar()->setValue(verticalScrollBar()->value() - delta);
 }
 
+void TextBrowser::fetchMore()
+{
+    // page older lines back in from the scrollback once the top is reached
+    TextDocument* doc = document();
+    if (doc && isAtTop() && !isAtBottom() && doc->canFetchMore()) {
+        const int count = doc->fetchMore(100);
+        if (count > 0) {
+            const QTextBlock block = doc->findBlockByNumber(count);
+            const QRectF br = doc->documentLayout()->blockBoundingRect(block);
+            QMetaObject::invokeMethod(this, "keepPosition", Qt::QueuedConnection, Q_ARG(int, -qRound(br.top())));
+        }
+    }
+}
+
 void TextBrowser::moveCursorToBottom()
 {
     QTextCursor cursor = textCursor();
@@ -78,10 +78,12 @@ protected:
     void paintEvent(QPaintEvent* event);
     void resizeEvent(QResizeEvent* event);
     void wheelEvent(QWheelEvent* event);
+    void changeEvent(QEvent* event);
 
 private slots:
     void keepAtBottom();
     void keepPosition(int delta);
+    void fetchMore();
     void onAnchorClicked(const QUrl& url);
 
     void onWhoisTriggered();
@@ -28,98 +28,169 @@
 
 #include "textdocument.h"
 #include "eventformatter.h"
+#include "flushscheduler.h"
+#include "formatpool.h"
+#include "formattemplate.h"
+#include "messagemodel.h"
+#include "richtextwriter.h"
+#include "scrollbackstore.h"
+#include "searchindex.h"
+#include "textframe.h"
 #include <QAbstractTextDocumentLayout>
 #include <QTextDocumentFragment>
 #include <QTextBlockUserData>
+#include <QElapsedTimer>
 #include <IrcConnection>
-#include <QStylePainter>
 #include <QApplication>
-#include <QStyleOption>
 #include <QTextCursor>
 #include <QTextBlock>
 #include <IrcMessage>
 #include <IrcBuffer>
+#include <algorithm>
 #include <QPalette>
 #include <QPointer>
 #include <QPainter>
-#include <QFrame>
 #include <qmath.h>
 
-static int delay = 1000;
+static int views = 0;
 
-class TextFrame : public QFrame
+// block layouts forced outside of painting, counted per second
+static int layouts = 0;
+static int layoutRate = 0;
+static QElapsedTimer layoutClock;
+
+static void countLayout()
 {
-public:
-    TextFrame(QWidget* parent = 0) : QFrame(parent)
-    {
-        setVisible(false);
-        setAttribute(Qt::WA_TranslucentBackground);
-        setAttribute(Qt::WA_NoSystemBackground);
+    if (!layoutClock.isValid() || layoutClock.elapsed() >= 1000) {
+        layoutRate = layoutClock.isValid() && layoutClock.elapsed() < 2000 ? layouts : 0;
+        layouts = 0;
+        layoutClock.start();
     }
+    ++layouts;
+}
+static const int window = 1000;
+static const int backlog = 256;
 
-    void paintEvent(QPaintEvent*)
-    {
-        QStyleOption option;
-        option.init(this);
-        QStylePainter painter(this);
-        painter.drawPrimitive(QStyle::PE_Widget, option);
-    }
-};
+// merged events shown per expanded tooltip
+static const int EventPage = 50;
 
-class TextHighlight : public TextFrame
+struct TextBlockMessageData : QTextBlockUserData
 {
-    Q_OBJECT
-public:
-    TextHighlight(QWidget* parent = 0) : TextFrame(parent) { }
+    TextBlockMessageData(const MessageData& data, int stamp) : data(data), stamp(stamp), page(0) { }
+    MessageData data;
+    int stamp;
+    // formatted merged events, filled in as they get expanded
+    QStringList events;
+    int page;
 };
 
-class TextLowlight : public TextFrame
+// messages that format the same regardless of when they get formatted
+static bool isDeferrable(IrcMessage* message)
 {
-    Q_OBJECT
-public:
-    TextLowlight(QWidget* parent = 0) : TextFrame(parent) { }
-};
+    switch (MessageData::effectiveType(message)) {
+        case IrcMessage::Private:
+        case IrcMessage::Notice:
+        case IrcMessage::Join:
+        case IrcMessage::Part:
+        case IrcMessage::Quit:
+        case IrcMessage::Nick:
+        case IrcMessage::Kick:
+            return true;
+        case IrcMessage::Mode:
+            return message->type() == IrcMessage::Mode && !static_cast<IrcModeMessage*>(message)->isReply();
+        case IrcMessage::Topic:
+            return message->type() == IrcMessage::Topic && !static_cast<IrcTopicMessage*>(message)->isReply()
+                    && !(message->flags() & IrcMessage::Implicit);
+        default:
+            return false;
+    }
+}
 
-struct TextBlockMessageData : QTextBlockUserData
+static qint64 toMSecs(const QDateTime& timestamp)
 {
-    TextBlockMessageData(const MessageData& data) : data(data) { }
-    MessageData data;
-};
+    return timestamp.isValid() ? timestamp.toMSecsSinceEpoch() : -1;
+}
+
+static QDateTime fromMSecs(qint64 msecs)
+{
+    return msecs < 0 ? QDateTime() : QDateTime::fromMSecsSinceEpoch(msecs);
+}
+
+static void setupBlock(QTextCursor& cursor, const MessageData& data, int stamp)
+{
+    cursor.block().setUserData(new TextBlockMessageData(data, stamp));
+
+    QTextBlockFormat format = cursor.blockFormat();
+    format.setLineHeight(125, QTextBlockFormat::ProportionalHeight);
+    if (data.type() == IrcMessage::Unknown)
+        format.setAlignment(Qt::AlignRight);
+    else
+        format.setAlignment(Qt::AlignLeft);
+    cursor.setBlockFormat(format);
+}
 
 TextDocument::TextDocument(IrcBuffer* buffer) : QTextDocument(buffer)
 {
     qRegisterMetaType<TextDocument*>();
 
     d.scrollbackMarkerPosition = -1;
+    d.top = 0;
+    d.cleared = 0;
+    d.rowOffset = 0;
     d.dirty = -1;
+    d.viewed = 0;
     d.rebuild = -1;
+    d.restyle = false;
+    d.restamp = false;
     d.lowlight = -1;
     d.clone = false;
-    d.batch = false;
+    d.batch = 0;
+    d.latestMessageSeen = -1;
+    d.latestMessageReceived = -1;
+    d.batchSeen = -1;
     d.buffer = buffer;
     d.visible = false;
+    d.model = 0;
+    d.events = 0;
+    d.expanded.page = 0;
 
+    d.writer = new RichTextWriter(this);
     d.formatter = new MessageFormatter(this);
     connect(d.formatter, SIGNAL(formatted(MessageData)), this, SLOT(append(MessageData)));
     d.formatter->setBuffer(buffer);
 
+    // lines evicted from the window go to a scrollback store that is
+    // shared by all documents of the buffer
+    d.store = buffer->findChild<ScrollbackStore*>(QString(), Qt::FindDirectChildrenOnly);
+    if (!d.store)
+        d.store = new ScrollbackStore(buffer);
+
     setUndoRedoEnabled(false);
-    setMaximumBlockCount(1000);
+    setMaximumBlockCount(window);
 
     connect(buffer->connection(), SIGNAL(disconnected()), this, SLOT(lowlight()));
     connect(buffer, SIGNAL(messageReceived(IrcMessage*)), this, SLOT(receiveMessage(IrcMessage*)));
 }
 
+TextDocument::~TextDocument()
+{
+    delete d.writer;
+    delete d.events;
+}
+
 QString TextDocument::timeStampFormat() const
 {
-    return d.timeStampFormat;
+    return d.timestamps.format();
 }
 
 void TextDocument::setTimeStampFormat(const QString& format)
 {
-    if (d.timeStampFormat != format) {
-        d.timeStampFormat = format;
-        scheduleRebuild();
+    if (d.timestamps.format() != format) {
+        d.timestamps.setFormat(format);
+        if (d.visible)
+            updateTimeStamps();
+        else if (!isEmpty())
+            d.restamp = true;
     }
 }
 
@@ -133,27 +204,53 @@ void TextDocument::setStyleSheet(const QString& css)
     if (d.css != css) {
         d.css = css;
         setDefaultStyleSheet(css);
+        d.writer->invalidate();
         scheduleRebuild();
     }
 }
 
 TextDocument* TextDocument::clone()
 {
-    if (d.dirty > 0)
-        flush();
+    if (d.origin)
+        return d.origin->clone();
+
+    flush();
 
     TextDocument* doc = new TextDocument(d.buffer);
     doc->setDefaultStyleSheet(defaultStyleSheet());
+    doc->setMaximumBlockCount(maximumBlockCount());
     QTextCursor(doc).insertFragment(QTextDocumentFragment(this));
     doc->rootFrame()->setFrameFormat(rootFrame()->frameFormat());
 
+    // fragments do not carry block user data
+    QTextBlock to = doc->firstBlock();
+    for (QTextBlock from = firstBlock(); from.isValid() && to.isValid(); from = from.next(), to = to.next()) {
+        if (TextBlockMessageData* blockData = static_cast<TextBlockMessageData*>(from.userData()))
+            to.setUserData(new TextBlockMessageData(blockData->data, blockData->stamp));
+    }
+
     // TODO:
     doc->d.scrollbackMarkerPosition = d.scrollbackMarkerPosition;
+    doc->d.top = d.top;
+    doc->d.cleared = d.cleared;
+    doc->d.rowOffset = d.rowOffset;
+    doc->d.restyle = d.restyle;
+    doc->d.restamp = d.restamp;
+
+    // clones do not format on their own, but get fed by the origin
+    doc->d.origin = this;
+    d.clones.removeAll(QPointer<TextDocument>());
+    d.clones += doc;
+    disconnect(d.buffer, SIGNAL(messageReceived(IrcMessage*)), doc, SLOT(receiveMessage(IrcMessage*)));
+    connect(d.formatter, SIGNAL(formatted(MessageData)), doc, SLOT(append(MessageData)));
     doc->d.css = d.css;
     doc->d.lowlight = d.lowlight;
     doc->d.buffer = d.buffer;
     doc->d.highlights = d.highlights;
-    doc->d.timeStampFormat = d.timeStampFormat;
+    doc->d.timestamps = d.timestamps;
+    doc->d.latestMessageSeen = d.latestMessageSeen;
+    doc->d.latestMessageReceived = d.latestMessageReceived;
+    doc->d.unseen = d.unseen;
     doc->d.clone = true;
 
     return doc;
@@ -174,6 +271,31 @@ MessageFormatter* TextDocument::formatter() const
     return d.formatter;
 }
 
+MessageModel* TextDocument::messageModel()
+{
+    // split views of the same buffer share the model of the origin
+    if (d.origin)
+        return d.origin->messageModel();
+
+    if (!d.model) {
+        flush();
+        d.model = new MessageModel(this);
+        for (QTextBlock block = firstBlock(); block.isValid(); block = block.next()) {
+            TextBlockMessageData* blockData = static_cast<TextBlockMessageData*>(block.userData());
+            if (blockData)
+                d.model->append(blockData->data);
+        }
+        foreach (const MessageData& message, d.queue)
+            d.model->append(message);
+
+        foreach (int highlight, d.highlights)
+            d.model->setHighlighted(modelRow(highlight), true);
+        if (d.lowlight != -1)
+            d.model->setLowlight(modelRow(d.lowlight));
+    }
+    return d.model;
+}
+
 int TextDocument::totalCount() const
 {
     int count = d.queue.count();
@@ -182,6 +304,69 @@ int TextDocument::totalCount() const
     return count;
 }
 
+int TextDocument::scrollbackLimit() const
+{
+    return d.store ? d.store->limit() : 0;
+}
+
+void TextDocument::setScrollbackLimit(int limit)
+{
+    if (d.store)
+        d.store->setLimit(limit);
+}
+
+bool TextDocument::canFetchMore() const
+{
+    return d.store && !isEmpty() && d.top > qMax(d.store->first(), d.cleared);
+}
+
+int TextDocument::fetchMore(int count)
+{
+    if (!canFetchMore())
+        return 0;
+
+    flush();
+
+    const int from = qMax(qMax(d.store->first(), d.cleared), d.top - count);
+    QList<MessageData> lines;
+    for (int i = from; i < d.top; ++i) {
+        MessageData line = d.store->at(i);
+        resolve(line);
+        lines += line;
+    }
+
+    TextBlockMessageData* blockData = static_cast<TextBlockMessageData*>(firstBlock().userData());
+    const bool hasData = blockData;
+    const MessageData data = hasData ? blockData->data : MessageData();
+    const int stamp = hasData ? blockData->stamp : -1;
+
+    // make room for the restored lines until the document is hidden again
+    setMaximumBlockCount(maximumBlockCount() + lines.count());
+
+    QTextCursor cursor(this);
+    cursor.beginEditBlock();
+    foreach (const MessageData& line, lines) {
+        insertBlock(cursor, formatBlock(line.msecs(), line.format()));
+        cursor.insertBlock();
+    }
+
+    // user data and block formats do not reliably follow split blocks
+    cursor.movePosition(QTextCursor::Start);
+    foreach (const MessageData& line, lines) {
+        setupBlock(cursor, line, stampLength(line));
+        cursor.movePosition(QTextCursor::NextBlock);
+    }
+    if (hasData)
+        setupBlock(cursor, data, stamp);
+    cursor.endEditBlock();
+
+    d.top = from;
+    shiftLights(-lines.count());
+    if (d.scrollbackMarkerPosition != -1)
+        d.scrollbackMarkerPosition += lines.count();
+    return lines.count();
+}
+
 bool TextDocument::isVisible() const
 {
     return d.visible;
@@ -192,17 +377,24 @@ void TextDocument::setVisible(bool visible)
     if (d.visible == visible)
         return;
 
+    d.viewed = ++views;
+
     if (visible) {
-        if (d.dirty > 0)
-            flush();
+        // apply the style changes that were held back while hidden
+        if (d.restyle)
+            rebuild();
+        else if (d.restamp)
+            updateTimeStamps();
+
+        flush();
 
         // Update scroll marker position before updating seen message timestamp
-        if (latestMessageReceived() > latestMessageSeen()) {
+        if (d.latestMessageReceived > d.latestMessageSeen) {
             Q_ASSERT(d.queue.isEmpty());
             QTextBlock block = lastBlock();
             while (block.isValid()) {
                 TextBlockMessageData* blockData = static_cast<TextBlockMessageData*>(block.userData());
-                if (blockData && blockData->data.timestamp() <= latestMessageSeen())
+                if (blockData && blockData->data.msecs() <= d.latestMessageSeen)
                     break;
 
                 d.scrollbackMarkerPosition = block.blockNumber();
@@ -213,6 +405,11 @@ void TextDocument::setVisible(bool visible)
         setLatestMessageSeen(latestMessageReceived());
     } else {
         d.scrollbackMarkerPosition = -1;
+
+        // return the lines that were paged in back to the scrollback
+        if (!isEmpty() && blockCount() > window)
+            evict(blockCount() - window);
+        setMaximumBlockCount(window);
     }
 
     d.visible = visible;
@@ -220,69 +417,46 @@ void TextDocument::setVisible(bool visible)
 
 QDateTime TextDocument::latestMessageReceived() const
 {
-    if (!d.queue.isEmpty())
-        return d.queue.last().timestamp();
-
-    QTextBlock block = lastBlock();
-    while (block.isValid()) {
-        if (TextBlockMessageData* blockData = static_cast<TextBlockMessageData*>(block.userData()))
-            return blockData->data.timestamp();
-
-        block = block.previous();
-    }
-
-    return QDateTime();
+    return fromMSecs(d.latestMessageReceived);
 }
 
 QDateTime TextDocument::latestMessageSeen() const
 {
-    return d.latestMessageSeen;
+    return fromMSecs(d.latestMessageSeen);
 }
 
 void TextDocument::setLatestMessageSeen(const QDateTime& timestamp)
 {
-    if (d.latestMessageSeen == timestamp)
+    const qint64 msecs = toMSecs(timestamp);
+    if (d.latestMessageSeen == msecs)
         return;
 
-    d.latestMessageSeen = timestamp;
+    if (msecs < d.latestMessageSeen) {
+        // moving backwards brings back lines that were already dropped
+        d.latestMessageSeen = msecs;
+        recount();
+    } else {
+        d.latestMessageSeen = msecs;
+        // unread lines are ordered by time, drop the ones now seen
+        while (!d.unseen.isEmpty() && d.unseen.first() <= msecs)
+            d.unseen.removeFirst();
+    }
     emit latestMessageSeenChanged(timestamp);
 }
 
-int TextDocument::unreadMessages() const
+// the number of layouts forced during the last full second
+int TextDocument::forcedLayouts()
 {
-    int unread = 0;
-
-    // Note: The following logic assumes the queue and blocks are ordered by time
-
-    QListIterator<MessageData> iterator(d.queue);
-    iterator.toBack();
-    while (iterator.hasPrevious()) {
-        MessageData message = iterator.previous();
-        if (message.timestamp() <= d.latestMessageSeen)
-            return unread;
-
-        if (message.type() != IrcMessage::Private && message.type() != IrcMessage::Notice)
-            continue;
-
-        ++unread;
-    }
-
-    for (QTextBlock block = lastBlock(); block.isValid(); block = block.previous()) {
-        TextBlockMessageData* blockData = static_cast<TextBlockMessageData*>(block.userData());
-        if (!blockData)
-            continue;
-
-        MessageData message = blockData->data;
-        if (message.timestamp() <= d.latestMessageSeen)
-            break;
-
-        if (message.type() != IrcMessage::Private && message.type() != IrcMessage::Notice)
-            continue;
-
-        ++unread;
-    }
+    if (!layoutClock.isValid() || layoutClock.elapsed() >= 2000)
+        return 0;
+    if (layoutClock.elapsed() >= 1000)
+        return layouts;
+    return layoutRate;
+}
 
-    return unread;
+int TextDocument::unreadMessages() const
+{
+    return d.unseen.count();
 }
 
 void TextDocument::lowlight(int block)
@@ -292,6 +466,8 @@ void TextDocument::lowlight(int block)
     if (d.lowlight != block) {
         d.lowlight = block;
         updateBlock(block);
+        if (d.model)
+            d.model->setLowlight(modelRow(block));
     }
 }
 
@@ -301,24 +477,61 @@ void TextDocument::addHighlight(int block)
     if (block == -1)
         block = max;
     if (block >= 0 && block <= max) {
-        QList<int>::iterator it = qLowerBound(d.highlights.begin(), d.highlights.end(), block);
+        QList<int>::iterator it = std::lower_bound(d.highlights.begin(), d.highlights.end(), block);
         d.highlights.insert(it, block);
         updateBlock(block);
+        if (d.model)
+            d.model->setHighlighted(modelRow(block), true);
     }
 }
 
 void TextDocument::removeHighlight(int block)
 {
-    if (d.highlights.removeOne(block) && block >= 0 && block < totalCount())
+    if (d.highlights.removeOne(block) && block >= 0 && block < totalCount()) {
         updateBlock(block);
+        if (d.model)
+            d.model->setHighlighted(modelRow(block), false);
+    }
 }
 
+// clears the document and its history; the clones keep their lines in
+// the shared store and model, so unless this is the only document left
+// it only pages back, and its views only show rows, from where it was
+// cleared
 void TextDocument::reset()
 {
+    const QList<TextDocument*> documents = group();
+    documents.first()->waitPending(0);
+
+    d.top += totalCount();
+    d.cleared = d.top;
+    if (d.store && documents.count() == 1)
+        d.store->clear();
+    clear();
+
+    MessageModel* model = documents.first()->d.model;
+    if (model) {
+        d.rowOffset = model->offset() + model->count();
+        if (documents.count() == 1)
+            model->clear();
+    }
+
     d.scrollbackMarkerPosition = -1;
     d.lowlight = -1;
     d.highlights.clear();
     d.queue.clear();
+    d.rows.clear();
+    d.unseen.clear();
+    d.latestMessageReceived = -1;
+    d.expanded = Expanded();
+    d.expanded.page = 0;
+}
+
+// the rows of the message model before this one were cleared from the
+// document, offset + row of the model compares to it
+int TextDocument::rowOffset() const
+{
+    return d.rowOffset;
 }
 
 void TextDocument::append(const MessageData& data)
@@ -330,21 +543,47 @@ void TextDocument::append(const MessageData& data)
         else if (TextBlockMessageData* block = static_cast<TextBlockMessageData*>(lastBlock().userData()))
             last = block->data;
 
-        if (!last.isEmpty() && data.type() != IrcMessage::Unknown && data.timestamp().date() != last.timestamp().date()) {
-            MessageData dc;
-            dc.setFormat(QString("<p class='date'>%1</p>").arg(data.timestamp().date().toString(Qt::ISODate)));
-            append(dc);
+        const qint64 timestamp = data.msecs();
+        if (!last.isEmpty() && data.type() != IrcMessage::Unknown) {
+            const qint64 day = d.timestamps.day(timestamp);
+            if (day != d.timestamps.day(last.msecs())) {
+                const QDate date = day < 0 ? QDate() : QDate::fromJulianDay(day);
+                MessageData dc;
+                dc.setFormat(QString("<p class='date'>%1</p>").arg(date.toString(Qt::ISODate)));
+                append(dc);
+            }
         }
 
+        // keep the unread count up to date instead of scanning for it
+        if (timestamp >= 0)
+            d.latestMessageReceived = timestamp;
+        if ((data.type() == IrcMessage::Private || data.type() == IrcMessage::Notice) && timestamp > d.latestMessageSeen)
+            d.unseen += timestamp;
+
         MessageData msg = data;
         const bool merge = last.canMerge(data);
         if (merge) {
             msg.merge(last);
-            msg.setFormat(formatSummary(msg.getEvents()));
+            // the summary of deferred events is built once they get resolved
+            if (!msg.isPending())
+                msg.setFormat(formatSummary(msg));
             if (!d.queue.isEmpty())
                 d.queue.replace(d.queue.count() - 1, msg);
         }
-        if (!d.batch && (d.dirty == 0 || d.visible)) {
+        if (d.model) {
+            if (d.batch && !(merge && d.rows.isEmpty())) {
+                // batched rows go into the model with a single insert
+                if (merge)
+                    d.rows.last() = msg;
+                else
+                    d.rows += msg;
+            } else if (merge) {
+                d.model->replaceLast(msg);
+            } else {
+                d.model->append(msg);
+            }
+        }
+        if (!d.batch && (d.visible || (d.dirty == 0 && !isLazy()))) {
             QTextCursor cursor(this);
             cursor.beginEditBlock();
             if (merge) {
@@ -356,16 +595,33 @@ void TextDocument::append(const MessageData& data)
             insert(cursor, msg);
             cursor.endEditBlock();
         } else {
-            if (!d.batch && d.dirty <= 0) {
-                d.dirty = startTimer(delay);
-                delay += 1000;
-            }
-            if (!merge)
+            // a line that merges into the last block takes its place in
+            // the queue, otherwise the merge would never reach the document
+            if (merge && d.queue.isEmpty()) {
+                removeLastBlock();
+                d.queue += msg;
+            } else if (!merge) {
                 d.queue += msg;
+            }
+
+            // hidden documents keep everything queued until they are shown
+            if (isLazy())
+                trimQueue();
+            else if (!d.batch)
+                scheduleFlush();
         }
     }
 }
 
+void TextDocument::removeLastBlock()
+{
+    QTextCursor cursor(this);
+    cursor.movePosition(QTextCursor::End);
+    cursor.movePosition(QTextCursor::StartOfBlock, QTextCursor::KeepAnchor);
+    cursor.removeSelectedText();
+    cursor.deletePreviousChar();
+}
+
 void TextDocument::drawForeground(QPainter* painter, const QRect& bounds)
 {
     if (d.scrollbackMarkerPosition <= 0)
@@ -440,16 +696,57 @@ void TextDocument::drawBackground(QPainter* painter, const QRect& bounds)
     }
 }
 
+// the block of the given search index line, or -1 if it has left the window
+int TextDocument::lineAt(int id) const
+{
+    for (QTextBlock block = lastBlock(); block.isValid(); block = block.previous()) {
+        TextBlockMessageData* blockData = static_cast<TextBlockMessageData*>(block.userData());
+        if (!blockData)
+            continue;
+        const int other = blockData->data.id();
+        if (other == id)
+            return block.blockNumber();
+        if (other >= 0 && other < id)
+            break;
+    }
+    return -1;
+}
+
+MessageData TextDocument::message(const QTextBlock& block) const
+{
+    TextBlockMessageData* blockData = static_cast<TextBlockMessageData*>(block.userData());
+    if (blockData)
+        return blockData->data;
+    return MessageData();
+}
+
+bool TextDocument::isHighlighted(int block) const
+{
+    return std::binary_search(d.highlights.constBegin(), d.highlights.constEnd(), block);
+}
+
 QString TextDocument::tooltip(const QPoint& point) const
 {
     const int pos = documentLayout()->hitTest(point, Qt::FuzzyHit);
     const QTextBlock block = findBlock(pos);
     TextBlockMessageData* blockData = static_cast<TextBlockMessageData*>(block.userData());
     if (blockData)
-        return formatEvents(blockData->data.getEvents());
+        return formatEvents(blockData->data, &blockData->events, &blockData->page);
     return QString();
 }
 
+// model rows have no block to keep the formatted events on, so the
+// last expanded row is remembered instead
+QString TextDocument::tooltip(const MessageData& message) const
+{
+    if (!d.expanded.data.isSharedWith(message)) {
+        d.expanded.data = message;
+        d.expanded.lines.clear();
+        d.expanded.page = 0;
+    }
+    return formatEvents(message, &d.expanded.lines, &d.expanded.page);
+}
+
 void TextDocument::updateBlock(int number)
 {
     if (d.visible) {
@@ -462,10 +759,7 @@ void TextDocument::updateBlock(int number)
 void TextDocument::timerEvent(QTimerEvent* event)
 {
     QTextDocument::timerEvent(event);
-    if (event->timerId() == d.dirty) {
-        delay -= 1000;
-        flush();
-    } else if (event->timerId() == d.rebuild) {
+    if (event->timerId() == d.rebuild) {
         rebuild();
     }
 }
@@ -475,76 +769,272 @@ void TextDocument::flush()
     if (!d.queue.isEmpty()) {
         QTextCursor cursor(this);
         cursor.beginEditBlock();
-        foreach (const MessageData& data, d.queue)
-            insert(cursor, data);
+        foreach (MessageData data, d.queue) {
+            resolve(data);
+            if (!data.isEmpty())
+                insert(cursor, data);
+        }
         cursor.endEditBlock();
         d.queue.clear();
     }
 
     if (d.dirty > 0) {
-        killTimer(d.dirty);
+        FlushScheduler::instance()->cancel(this);
         d.dirty = 0;
     }
 }
 
+bool TextDocument::drain(int count)
+{
+    if (!d.queue.isEmpty()) {
+        QTextCursor cursor(this);
+        cursor.beginEditBlock();
+        for (int i = 0; i < count && !d.queue.isEmpty(); ++i) {
+            MessageData data = d.queue.takeFirst();
+            resolve(data);
+            if (!data.isEmpty())
+                insert(cursor, data);
+        }
+        cursor.endEditBlock();
+    }
+
+    if (!d.queue.isEmpty())
+        return true;
+
+    d.dirty = 0;
+    return false;
+}
+
+void TextDocument::scheduleFlush()
+{
+    if (d.dirty <= 0) {
+        d.dirty = 1;
+        FlushScheduler::instance()->schedule(this);
+    }
+}
+
 void TextDocument::receiveMessage(IrcMessage* message)
 {
+    const QList<TextDocument*> documents = group();
     if (message->type() == IrcMessage::Batch) {
-        IrcBatchMessage* batch = static_cast<IrcBatchMessage*>(message);
-        d.batch = true;
-        foreach (IrcMessage* msg, batch->messages())
-            receiveMessage(msg);
-        d.batch = false;
-        if (!d.queue.isEmpty()) {
-            if (d.visible) {
-                flush();
-            } else if (d.dirty <= 0) {
-                d.dirty = startTimer(delay);
-                delay += 1000;
-            }
-        }
+        receiveMessages(static_cast<IrcBatchMessage*>(message)->messages());
+        return;
+    }
+
+    // message text is rendered in the format pool unless the whole
+    // group formats lazily, anything else waits behind it in order
+    bool lazy = true;
+    foreach (TextDocument* doc, documents)
+        lazy &= doc->isLazy();
+
+    QString text;
+    if (!lazy && FormatPool::instance()->isActive() && d.formatter->hasDefaultTextFormat()) {
+        if (message->type() == IrcMessage::Private)
+            text = static_cast<IrcPrivateMessage*>(message)->content();
+        else if (message->type() == IrcMessage::Notice)
+            text = static_cast<IrcNoticeMessage*>(message)->content();
+    }
+
+    // nothing to render and nothing ahead of it, it goes out as is
+    if (text.isEmpty() && d.pending.isEmpty()) {
+        dispatch(message);
+        return;
+    }
+
+    // the sender deletes the message as soon as it has been received, so
+    // a copy of it waits for the rendered text, or its turn, instead; one
+    // that cannot be copied cannot wait and goes out ahead of its turn
+    IrcMessage* copy = IrcMessage::fromData(message->toData(), message->connection());
+    if (!copy) {
+        dispatch(message);
+        return;
+    }
+    copy->setParent(this);
+    copy->setTimeStamp(message->timeStamp());
+
+    Pending pending;
+    pending.message = copy;
+    if (!text.isEmpty())
+        pending.task = FormatPool::instance()->render(text, d.formatter->names());
+    if (d.pending.isEmpty())
+        connect(FormatPool::instance(), SIGNAL(finished()), this, SLOT(deliver()), Qt::UniqueConnection);
+    d.pending += pending;
+
+    // backpressure, a flood is not allowed to queue up without bounds
+    waitPending(backlog);
+}
+
+// delivers rendered messages in the order they were received
+void TextDocument::deliver()
+{
+    while (!d.pending.isEmpty()) {
+        const QSharedPointer<FormatTask>& task = d.pending.first().task;
+        if (task && !task->isDone())
+            return;
+        const Pending pending = d.pending.takeFirst();
+        complete(pending.message, pending.task);
+    }
+    disconnect(FormatPool::instance(), SIGNAL(finished()), this, SLOT(deliver()));
+}
+
+// messages without text to render are complete as soon as their turn comes
+void TextDocument::complete(IrcMessage* message, const QSharedPointer<FormatTask>& task)
+{
+    if (task)
+        d.formatter->setPrerendered(task->text(), task->html());
+    dispatch(message);
+    if (task)
+        d.formatter->setPrerendered(QString(), QString());
+    delete message;
+}
+
+// renders and delivers the oldest messages until at most count are left
+void TextDocument::waitPending(int count)
+{
+    while (d.pending.count() > count) {
+        if (const QSharedPointer<FormatTask>& task = d.pending.first().task)
+            task->wait();
+        deliver();
+    }
+}
+
+void TextDocument::dispatch(IrcMessage* message)
+{
+    const QList<TextDocument*> documents = group();
+
+    // formatting can wait only if none of the clones needs it either
+    bool lazy = isDeferrable(message);
+    foreach (TextDocument* doc, documents)
+        lazy &= doc->isLazy();
+
+    MessageData data;
+    if (lazy) {
+        data.initFrom(message, d.formatter->arena());
+        data.setPending(true);
     } else {
-        MessageData data = d.formatter->formatMessage(message);
-        if (!data.isEmpty()) {
-            bool unseen = message->timeStamp() > latestMessageSeen();
+        data = d.formatter->formatMessage(message);
+    }
+    if (!data.isEmpty()) {
+        // lines said anywhere can be found again with the global search,
+        // once per buffer no matter how many clones show them
+        if (data.type() == IrcMessage::Private)
+            data.setId(SearchIndex::instance()->add(d.buffer, data, static_cast<IrcPrivateMessage*>(message)->content()));
+        else if (data.type() == IrcMessage::Notice)
+            data.setId(SearchIndex::instance()->add(d.buffer, data, static_cast<IrcNoticeMessage*>(message)->content()));
+
+        foreach (TextDocument* doc, documents)
+            doc->process(message, data);
+    }
+}
 
-            append(data);
+// bouncer and chathistory playback arrives in bulk, the lines are laid
+// out, mirrored to the model and marked seen once at the end
+void TextDocument::receiveMessages(const QList<IrcMessage*>& messages)
+{
+    const QList<TextDocument*> documents = group();
+    foreach (TextDocument* doc, documents)
+        ++doc->d.batch;
+    foreach (IrcMessage* msg, messages)
+        receiveMessage(msg);
+    foreach (TextDocument* doc, documents)
+        doc->endBatch();
+}
 
-            if (unseen && isVisible() && !(message->isOwn() && data.type() == IrcMessage::Join))
-                setLatestMessageSeen(message->timeStamp());
+void TextDocument::endBatch()
+{
+    // the batch was rendered in parallel, collect it before laying it out
+    if (d.batch == 1)
+        waitPending(0);
 
-            if (data.type() == IrcMessage::Private || data.type() == IrcMessage::Notice) {
+    if (--d.batch > 0)
+        return;
+
+    if (d.model && !d.rows.isEmpty()) {
+        const int first = totalCount() - d.rows.count();
+        const QList<MessageData> rows = d.rows;
+        d.rows.clear();
+        d.model->append(rows);
+        foreach (int highlight, d.highlights) {
+            if (highlight >= first)
+                d.model->setHighlighted(modelRow(highlight), true);
+        }
+        if (d.lowlight >= first)
+            d.model->setLowlight(modelRow(d.lowlight));
+    }
+
+    if (!d.queue.isEmpty()) {
+        if (d.visible) {
+            // whatever does not fit the window goes straight to the scrollback
+            trimQueue();
+            flush();
+        } else if (!isLazy()) {
+            scheduleFlush();
+        }
+    }
+
+    if (d.batchSeen >= 0) {
+        const qint64 timestamp = d.batchSeen;
+        d.batchSeen = -1;
+        setLatestMessageSeen(fromMSecs(timestamp));
+    }
+}
+
+void TextDocument::process(IrcMessage* message, const MessageData& data)
+{
+    bool unseen = toMSecs(message->timeStamp()) > d.latestMessageSeen;
+
+    append(data);
+
+    if (unseen && isVisible() && !(message->isOwn() && data.type() == IrcMessage::Join)) {
+        if (d.batch)
+            d.batchSeen = toMSecs(message->timeStamp());
+        else
+            setLatestMessageSeen(message->timeStamp());
+    }
+
+    if (data.type() == IrcMessage::Private || data.type() == IrcMessage::Notice) {
+        if (unseen)
+            emit messageReceived(message);
+
+        if (!message->isOwn()) {
+            QString content;
+            bool priv = false;
+            if (data.type() == IrcMessage::Private) {
+                IrcPrivateMessage* pm = static_cast<IrcPrivateMessage*>(message);
+                content = pm->content();
+                priv = pm->isPrivate();
+            } else {
+                IrcNoticeMessage* nm = static_cast<IrcNoticeMessage*>(message);
+                content = nm->content();
+                priv = nm->isPrivate();
+            }
+            IrcConnection* connection = message->connection();
+            const bool contains = content.contains(connection->nickName(), Qt::CaseInsensitive);
+            if (contains) {
+                if (connection->isConnected())
+                    addHighlight(totalCount() - 1);
                 if (unseen)
-                    emit messageReceived(message);
-
-                if (!message->isOwn()) {
-                    QString content;
-                    bool priv = false;
-                    if (data.type() == IrcMessage::Private) {
-                        IrcPrivateMessage* pm = static_cast<IrcPrivateMessage*>(message);
-                        content = pm->content();
-                        priv = pm->isPrivate();
-                    } else {
-                        IrcNoticeMessage* nm = static_cast<IrcNoticeMessage*>(message);
-                        content = nm->content();
-                        priv = nm->isPrivate();
-                    }
-                    IrcConnection* connection = message->connection();
-                    const bool contains = content.contains(connection->nickName(), Qt::CaseInsensitive);
-                    if (contains) {
-                        if (connection->isConnected())
-                            addHighlight(totalCount() - 1);
-                        if (unseen)
-                            emit messageHighlighted(message);
-                    } else if (unseen && priv && connection->isConnected()) {
-                        emit privateMessageReceived(message);
-                    }
-                }
+                    emit messageHighlighted(message);
+            } else if (unseen && priv && connection->isConnected()) {
+                emit privateMessageReceived(message);
             }
         }
     }
 }
 
+// the document that receives and formats messages, followed by its clones
+QList<TextDocument*> TextDocument::group()
+{
+    TextDocument* origin = d.origin ? d.origin.data() : this;
+    QList<TextDocument*> documents;
+    documents += origin;
+    foreach (const QPointer<TextDocument>& clone, origin->d.clones) {
+        if (clone)
+            documents += clone;
+    }
+    return documents;
+}
+
 void TextDocument::rebuild()
 {
     QList<MessageData> lines;
@@ -556,18 +1046,84 @@ void TextDocument::rebuild()
         block = block.next();
     }
     clear();
-    d.queue = lines;
-    flush();
+    if (isLazy()) {
+        const QList<MessageData> queue = d.queue;
+        d.queue = lines;
+        flush();
+        d.queue = queue;
+    } else {
+        d.queue = lines + d.queue;
+        flush();
+    }
     if (d.rebuild > 0) {
         killTimer(d.rebuild);
         d.rebuild = 0;
     }
+    d.restyle = false;
+    d.restamp = false;
 }
 
+// only visible documents are rebuilt right away, hidden documents
+// get rebuilt when they are shown the next time
 void TextDocument::scheduleRebuild()
 {
-    if (d.rebuild < 0 && !isEmpty())
-        d.rebuild = startTimer(isVisible() ? 0 : 1000);
+    if (isEmpty())
+        return;
+
+    if (!d.visible)
+        d.restyle = true;
+    else if (d.rebuild <= 0)
+        d.rebuild = startTimer(0);
+}
+
+// replaces the leading timestamp of each block in place, which keeps
+// the rest of the block and its layout-independent formats untouched
+void TextDocument::updateTimeStamps()
+{
+    d.restamp = false;
+
+    for (QTextBlock block = firstBlock(); block.isValid(); block = block.next()) {
+        TextBlockMessageData* blockData = static_cast<TextBlockMessageData*>(block.userData());
+        if (blockData && !blockData->data.format().isEmpty()
+                && (blockData->stamp < 0 || stampLength(blockData->data) < 0)) {
+            rebuild();
+            return;
+        }
+    }
+
+    // the timestamp format as the style sheet resolves it
+    QTextDocument probe;
+    probe.setDefaultFont(defaultFont());
+    probe.setDefaultStyleSheet(defaultStyleSheet());
+    probe.setHtml("<span class='timestamp'>0</span>");
+    QTextCursor probeCursor(&probe);
+    probeCursor.setPosition(1);
+    const QTextCharFormat format = probeCursor.charFormat();
+
+    QTextCursor cursor(this);
+    cursor.beginEditBlock();
+    for (QTextBlock block = firstBlock(); block.isValid(); block = block.next()) {
+        TextBlockMessageData* blockData = static_cast<TextBlockMessageData*>(block.userData());
+        if (!blockData || blockData->data.format().isEmpty())
+            continue;
+
+        const QString time = d.timestamps.render(blockData->data.msecs());
+        cursor.setPosition(block.position());
+        cursor.setPosition(block.position() + blockData->stamp, QTextCursor::KeepAnchor);
+        cursor.insertText(time, format);
+        blockData->stamp = time.length();
+    }
+    cursor.endEditBlock();
+}
+
+// the length of the plain text timestamp at the beginning of a block,
+// or -1 if the html import may have altered it
+int TextDocument::stampLength(const MessageData& data) const
+{
+    const QString time = d.timestamps.render(data.msecs());
+    if (time != time.simplified() || time.contains('<') || time.contains('&'))
+        return -1;
+    return time.length();
 }
 
 void TextDocument::shiftLights(int diff)
@@ -580,7 +1136,137 @@ void TextDocument::shiftLights(int diff)
         else
             ++it;
     }
-    d.lowlight -= diff;
+    if (d.lowlight != -1)
+        d.lowlight = qMax(-1, d.lowlight - diff);
+}
+
+void TextDocument::evict(int count)
+{
+    if (isEmpty())
+        return;
+
+    int removed = 0;
+    QTextBlock block = firstBlock();
+    for (; removed < count && block.isValid(); ++removed) {
+        // lines that were paged in are already in the store, and so are
+        // lines that another document of the same buffer has evicted
+        if (d.store && d.top >= d.store->count()) {
+            TextBlockMessageData* blockData = static_cast<TextBlockMessageData*>(block.userData());
+            d.store->append(d.top, blockData ? blockData->data : MessageData());
+        }
+        ++d.top;
+        block = block.next();
+    }
+
+    if (!block.isValid()) {
+        clear();
+        shiftLights(removed);
+        return;
+    }
+
+    TextBlockMessageData* blockData = static_cast<TextBlockMessageData*>(block.userData());
+    const bool hasData = blockData;
+    const MessageData data = hasData ? blockData->data : MessageData();
+    const int stamp = hasData ? blockData->stamp : -1;
+
+    QTextCursor cursor(this);
+    cursor.setPosition(block.position(), QTextCursor::KeepAnchor);
+    cursor.removeSelectedText();
+
+    // the first block survives the removal, so it takes over the data
+    // and format of the block that ends up at the top
+    if (hasData)
+        setupBlock(cursor, data, stamp);
+    else
+        cursor.block().setUserData(0);
+
+    shiftLights(removed);
+}
+
+void TextDocument::trimQueue()
+{
+    int excess = totalCount() - maximumBlockCount();
+    if (excess > 0 && !isEmpty()) {
+        const int blocks = qMin(excess, blockCount());
+        evict(blocks);
+        excess -= blocks;
+    }
+
+    for (; excess > 0 && !d.queue.isEmpty(); --excess) {
+        if (d.store && d.top >= d.store->count())
+            d.store->append(d.top, d.queue.first());
+        d.queue.removeFirst();
+        ++d.top;
+        shiftLights(1);
+    }
+}
+
+void TextDocument::recount()
+{
+    d.unseen.clear();
+
+    // Note: The following logic assumes the queue and blocks are ordered by time
+
+    QListIterator<MessageData> iterator(d.queue);
+    iterator.toBack();
+    while (iterator.hasPrevious()) {
+        MessageData message = iterator.previous();
+        if (message.msecs() <= d.latestMessageSeen)
+            return;
+
+        if (message.type() != IrcMessage::Private && message.type() != IrcMessage::Notice)
+            continue;
+
+        d.unseen.prepend(message.msecs());
+    }
+
+    for (QTextBlock block = lastBlock(); block.isValid(); block = block.previous()) {
+        TextBlockMessageData* blockData = static_cast<TextBlockMessageData*>(block.userData());
+        if (!blockData)
+            continue;
+
+        MessageData message = blockData->data;
+        if (message.msecs() <= d.latestMessageSeen)
+            break;
+
+        if (message.type() != IrcMessage::Private && message.type() != IrcMessage::Notice)
+            continue;
+
+        d.unseen.prepend(message.msecs());
+    }
+}
+
+// hidden documents format only once they are shown, unless a list
+// model mirrors them and needs formatted lines right away
+bool TextDocument::isLazy() const
+{
+    return !d.visible && !d.model;
+}
+
+void TextDocument::resolve(MessageData& data)
+{
+    if (!data.isPending())
+        return;
+
+    if (data.getEvents().count() > 1) {
+        data.setFormat(formatSummary(data));
+    } else {
+        IrcMessage* msg = IrcMessage::fromData(data.data(), d.buffer->connection());
+        if (msg) {
+            msg->setTimeStamp(data.timestamp());
+            data.setFormat(d.formatter->formatMessage(msg).format());
+            delete msg;
+        }
+    }
+    data.setPending(false);
+}
+
+// the model may hold more lines than the document, but both end at the same line
+int TextDocument::modelRow(int block) const
+{
+    // rows of a batch in progress are not in the model yet
+    const int row = block + d.model->count() + d.rows.count() - totalCount();
+    return row < d.model->count() ? row : -1;
 }
 
 void TextDocument::insert(QTextCursor& cursor, const MessageData& data)
@@ -590,96 +1276,121 @@ void TextDocument::insert(QTextCursor& cursor, const MessageData& data)
     if (!isEmpty()) {
         const int count = blockCount();
         const int max = maximumBlockCount();
-        const QRectF br = documentLayout()->blockBoundingRect(findBlockByNumber(0));
-        cursor.insertBlock();
-
         if (count >= max) {
-            emit lineRemoved(qRound(br.bottom()));
-            shiftLights(max - count + 1);
+            // only a visible document needs to know how far its view shifts
+            const int evicted = count - max + 1;
+            int height = 0;
+            if (d.visible) {
+                countLayout();
+                height = qRound(documentLayout()->blockBoundingRect(findBlockByNumber(evicted - 1)).bottom());
+            }
+            evict(evicted);
+            if (d.visible)
+                emit lineRemoved(height);
+            cursor.movePosition(QTextCursor::End);
         }
-    }
 
-    cursor.insertHtml(formatBlock(data.timestamp(), data.format()));
-    cursor.block().setUserData(new TextBlockMessageData(data));
+        cursor.insertBlock();
+    }
 
-    QTextBlockFormat format = cursor.blockFormat();
-    format.setLineHeight(125, QTextBlockFormat::ProportionalHeight);
-    if (data.type() == IrcMessage::Unknown)
-        format.setAlignment(Qt::AlignRight);
-    else
-        format.setAlignment(Qt::AlignLeft);
-    cursor.setBlockFormat(format);
+    insertBlock(cursor, formatBlock(data.msecs(), data.format()));
+    setupBlock(cursor, data, stampLength(data));
 }
 
-QString TextDocument::formatEvents(const QList<MessageData>& events) const
+// writes the formatter's markup as char formats directly, unknown markup
+// from plugins still goes through the full html parser
+void TextDocument::insertBlock(QTextCursor& cursor, const QString& html)
 {
-    EventFormatter formatter;
-    formatter.setBuffer(d.buffer);
+    if (!d.writer->write(cursor, html))
+        cursor.insertHtml(html);
+}
 
-    QStringList lines;
-    foreach (const MessageData& event, events) {
-        if (!event.isEmpty()) {
-            IrcMessage* msg = IrcMessage::fromData(event.data(), d.buffer->connection());
-            lines += formatBlock(event.timestamp(), formatter.formatMessage(msg).format());
-            delete msg;
+// formats merged events a page at a time into the given cache, and
+// moves on to the next page so that expanding again shows more
+QString TextDocument::formatEvents(const MessageData& message, QStringList* lines, int* page) const
+{
+    const QList<MessageData> events = message.getEvents();
+    const int pages = (events.count() + EventPage - 1) / EventPage;
+    if (pages == 0)
+        return QString();
+    if (*page >= pages)
+        *page = 0;
+
+    const int from = *page * EventPage;
+    const int to = qMin(from + EventPage, events.count());
+    if (lines->count() < to) {
+        EventFormatter* formatter = eventFormatter();
+        for (int i = lines->count(); i < to; ++i) {
+            const MessageData& event = events.at(i);
+            QString line;
+            if (!event.isEmpty()) {
+                IrcMessage* msg = IrcMessage::fromData(event.data(), d.buffer->connection());
+                line = formatBlock(event.msecs(), formatter->formatMessage(msg).format());
+                delete msg;
+            }
+            *lines += line;
         }
     }
-    if (!lines.isEmpty())
-        return tr("<html><head><style>%1</style></head><body style='white-space:pre'>%2</body></html>").arg(d.css, lines.join(tr("<br/>")));
-    return QString();
+
+    QStringList shown;
+    for (int i = from; i < to; ++i) {
+        if (!lines->at(i).isEmpty())
+            shown += lines->at(i);
+    }
+    if (pages > 1)
+        shown += MessageFormatter::styled(tr("%1-%2 of %3, click again for more").arg(from + 1).arg(to).arg(events.count()), MessageFormatter::Dim);
+    *page = (*page + 1) % pages;
+
+    if (shown.isEmpty())
+        return QString();
+    return tr("<html><head><style>%1</style></head><body style='white-space:pre'>%2</body></html>").arg(d.css, shown.join(tr("<br/>")));
+}
+
+// created on first use and shared by tooltips and summaries
+EventFormatter* TextDocument::eventFormatter() const
+{
+    if (!d.events) {
+        d.events = new EventFormatter;
+        d.events->setBuffer(d.buffer);
+    }
+    return d.events;
 }
 
-QString TextDocument::formatSummary(const QList<MessageData>& events) const
+QString TextDocument::formatSummary(const MessageData& data) const
 {
+    const MessageData::Summary summary = data.summary();
+
     QStringList actions;
     QStringList changes;
-    QSet<QString> nicks;
-    QSet<IrcMessage::Type> handled;
-    EventFormatter formatter;
-
-    foreach (const MessageData& event, events) {
-        switch (event.type()) {
+    foreach (IrcMessage::Type type, summary.types) {
+        switch (type) {
         case IrcMessage::Join:
-            if (!handled.contains(event.type()))
-                actions += tr("joined");
+            actions += tr("joined");
             break;
         case IrcMessage::Part:
-            if (!handled.contains(event.type()))
-                actions += tr("left");
+            actions += tr("left");
+            break;
+        case IrcMessage::Error:
+            actions += tr("disconnected");
             break;
         case IrcMessage::Quit:
-            if (event.isError()) {
-                if (!handled.contains(IrcMessage::Error))
-                    actions += tr("disconnected");
-                nicks.insert(event.nick());
-                handled.insert(IrcMessage::Error);
-                continue;
-            } else {
-                if (!handled.contains(event.type()))
-                    actions += tr("quit");
-            }
+            actions += tr("quit");
             break;
         case IrcMessage::Kick:
-            if (!handled.contains(event.type()))
-                actions += tr("kicked");
+            actions += tr("kicked");
             break;
         case IrcMessage::Nick:
-            if (!handled.contains(event.type()))
-                changes += tr("nick");
+            changes += tr("nick");
             break;
         case IrcMessage::Mode:
-            if (!handled.contains(event.type()))
-                changes += tr("mode");
+            changes += tr("mode");
             break;
         case IrcMessage::Topic:
-            if (!handled.contains(event.type()))
-                changes += tr("topic");
+            changes += tr("topic");
             break;
         default:
             break;
         }
-        nicks.insert(event.nick());
-        handled.insert(event.type());
     }
 
     if (!changes.isEmpty())
@@ -688,21 +1399,20 @@ QString TextDocument::formatSummary(const QList<MessageData>& events) const
     if (actions.count() > 2)
         actions = QStringList() << QStringList(actions.mid(0, actions.count() - 1)).join(tr(", ")) << actions.last();
 
-    if (nicks.count() == 1)
-        return formatter.formatEvent(tr("%1 %2").arg(formatter.styledText(*nicks.begin(), MessageFormatter::Bold),
-                                                     actions.join(tr(" and "))));
+    EventFormatter* formatter = eventFormatter();
+    if (summary.nicks.count() == 1)
+        return formatter->formatEvent(tr("%1 %2").arg(formatter->styledText(*summary.nicks.begin(), MessageFormatter::Bold),
+                                                      actions.join(tr(" and "))));
 
-    return formatter.formatEvent(tr("%1 %2").arg(formatter.styledText(tr("%1 users").arg(nicks.count()), MessageFormatter::Bold),
-                                                 actions.join(tr(" or "))));
+    return formatter->formatEvent(tr("%1 %2").arg(formatter->styledText(tr("%1 users").arg(summary.nicks.count()), MessageFormatter::Bold),
+                                                  actions.join(tr(" or "))));
 }
 
-QString TextDocument::formatBlock(const QDateTime& timestamp, const QString& message) const
+QString TextDocument::formatBlock(qint64 timestamp, const QString& message) const
 {
     if (message.isEmpty())
         return QString();
 
-    const QString time = timestamp.time().toString(d.timeStampFormat);
-    return tr("<span class='timestamp'>%1</span> %2").arg(time, message);
+    const FormatTemplate block = FormatTemplate::translated(staticMetaObject.className(), QT_TR_NOOP("<span class='timestamp'>%1</span> %2"));
+    return block.arg(d.timestamps.render(timestamp), message);
 }
-
-#include "textdocument.moc"
@@ -32,13 +32,23 @@
 #include <QTextDocument>
 #include <QMetaType>
 #include <QDateTime>
+#include <QPointer>
+#include <QStringList>
+#include <QSharedPointer>
 #include "baseglobal.h"
 #include "messagedata.h"
+#include "timestamprenderer.h"
 
 class IrcBuffer;
+class QTextBlock;
 class IrcMessage;
 class MessageData;
+class MessageModel;
 class MessageFormatter;
+class EventFormatter;
+class RichTextWriter;
+class FormatTask;
+class ScrollbackStore;
 
 class BASE_EXPORT TextDocument : public QTextDocument
 {
@@ -46,6 +56,7 @@ class BASE_EXPORT TextDocument : public QTextDocument
 
 public:
     explicit TextDocument(IrcBuffer* buffer);
+    ~TextDocument();
 
     QString timeStampFormat() const;
     void setTimeStampFormat(const QString& format);
@@ -58,9 +69,16 @@ public:
 
     IrcBuffer* buffer() const;
     MessageFormatter* formatter() const;
+    MessageModel* messageModel();
 
     int totalCount() const;
 
+    int scrollbackLimit() const;
+    void setScrollbackLimit(int limit);
+
+    bool canFetchMore() const;
+    int fetchMore(int count);
+
     bool isVisible() const;
     void setVisible(bool visible);
 
@@ -70,19 +88,28 @@ public:
 
     int unreadMessages() const;
 
+    static int forcedLayouts();
+
     void drawBackground(QPainter* painter, const QRect& bounds);
     void drawForeground(QPainter* painter, const QRect& bounds);
 
+    int lineAt(int id) const;
+    MessageData message(const QTextBlock& block) const;
+    bool isHighlighted(int block) const;
+
     QString tooltip(const QPoint& pos) const;
+    QString tooltip(const MessageData& message) const;
 
 public slots:
     void reset();
+    int rowOffset() const;
     void lowlight(int block = -1);
     void addHighlight(int block = -1);
     void removeHighlight(int block);
     void append(const MessageData& message);
     void insert(QTextCursor& cursor, const MessageData& message);
     void receiveMessage(IrcMessage* message);
+    void receiveMessages(const QList<IrcMessage*>& messages);
 
 signals:
     void lineRemoved(int height);
@@ -98,32 +125,83 @@ protected:
 private slots:
     void flush();
     void rebuild();
+    void deliver();
 
 private:
     void scheduleRebuild();
+    void updateTimeStamps();
+    int stampLength(const MessageData& data) const;
+    void scheduleFlush();
+    void endBatch();
+    void dispatch(IrcMessage* message);
+    void complete(IrcMessage* message, const QSharedPointer<FormatTask>& task);
+    void waitPending(int count);
+    bool drain(int count);
     void shiftLights(int diff);
-
-    QString formatEvents(const QList<MessageData>& events) const;
-    QString formatSummary(const QList<MessageData>& events) const;
-    QString formatBlock(const QDateTime& timestamp, const QString& message) const;
+    void evict(int count);
+    void trimQueue();
+    void removeLastBlock();
+    void insertBlock(QTextCursor& cursor, const QString& html);
+    void recount();
+    bool isLazy() const;
+    QList<TextDocument*> group();
+    void process(IrcMessage* message, const MessageData& data);
+    void resolve(MessageData& data);
+    int modelRow(int block) const;
+
+    QString formatEvents(const MessageData& message, QStringList* lines, int* page) const;
+    QString formatSummary(const MessageData& data) const;
+    EventFormatter* eventFormatter() const;
+    QString formatBlock(qint64 timestamp, const QString& message) const;
 
     friend class TextBrowser;
+    friend class MessageModel;
+    friend class FlushScheduler;
+
+    struct Pending {
+        IrcMessage* message;
+        QSharedPointer<FormatTask> task;
+    };
+
+    struct Expanded {
+        MessageData data;
+        QStringList lines;
+        int page;
+    };
 
     struct Private {
         int scrollbackMarkerPosition;
+        int top;
+        int cleared;
+        int rowOffset;
         int dirty;
+        int viewed;
         bool clone;
-        bool batch;
+        int batch;
         int rebuild;
+        bool restyle;
+        bool restamp;
         QString css;
         int lowlight;
         bool visible;
         IrcBuffer* buffer;
-        QDateTime latestMessageSeen;
+        qint64 latestMessageSeen;
+        qint64 latestMessageReceived;
+        qint64 batchSeen;
+        QList<MessageData> rows;
+        QList<Pending> pending;
+        QList<qint64> unseen;
         QList<int> highlights;
-        QString timeStampFormat;
+        TimeStampRenderer timestamps;
         QList<MessageData> queue;
+        MessageModel* model;
         MessageFormatter* formatter;
+        mutable EventFormatter* events;
+        mutable Expanded expanded;
+        RichTextWriter* writer;
+        QPointer<ScrollbackStore> store;
+        QPointer<TextDocument> origin;
+        QList<QPointer<TextDocument> > clones;
     } d;
 };
 
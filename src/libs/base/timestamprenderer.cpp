@@ -0,0 +1,228 @@
+/*
+  Copyright (C) 2008-2016 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "timestamprenderer.h"
+#include <QDateTime>
+#include <QLocale>
+
+static const qint64 MSecsPerDay = 86400000;
+
+// the format pattern is split into fields once, rendering then only
+// does integer arithmetic on the time of day of the cached local day,
+// and consecutive lines within the same second share the same string
+
+TimeStampRenderer::TimeStampRenderer(const QString& format)
+{
+    d.key = -1;
+    d.start = 0;
+    d.end = 0;
+    d.day = -1;
+    setFormat(format);
+}
+
+QString TimeStampRenderer::format() const
+{
+    return d.format;
+}
+
+void TimeStampRenderer::setFormat(const QString& format)
+{
+    d.format = format;
+    d.exact = true;
+    d.precise = false;
+    d.tokens.clear();
+    d.key = -1;
+    d.text.clear();
+
+    bool ampm = false;
+    QString literal;
+    const int length = format.length();
+    for (int i = 0; i < length; ) {
+        const QChar c = format.at(i);
+        if (c == QLatin1Char('\'')) {
+            // quoted text, where two quotes stand for a literal quote
+            int j = i + 1;
+            while (j < length) {
+                if (format.at(j) == c) {
+                    if (j + 1 < length && format.at(j + 1) == c) {
+                        literal += c;
+                        j += 2;
+                        continue;
+                    }
+                    if (j == i + 1)
+                        literal += c;
+                    break;
+                }
+                literal += format.at(j++);
+            }
+            i = j + 1;
+            continue;
+        }
+
+        int repeat = 1;
+        while (i + repeat < length && format.at(i + repeat) == c)
+            ++repeat;
+
+        Token token = { Literal, 0, QString() };
+        int consumed = 1;
+        if (c == QLatin1Char('h') || c == QLatin1Char('H')) {
+            token.field = c == QLatin1Char('h') ? Hour12 : Hour;
+            consumed = token.width = qMin(repeat, 2);
+        } else if (c == QLatin1Char('m')) {
+            token.field = Minute;
+            consumed = token.width = qMin(repeat, 2);
+        } else if (c == QLatin1Char('s')) {
+            token.field = Second;
+            consumed = token.width = qMin(repeat, 2);
+        } else if (c == QLatin1Char('z')) {
+            token.field = MSec;
+            consumed = token.width = repeat >= 3 ? 3 : 1;
+            d.precise = true;
+        } else if (c == QLatin1Char('a') || c == QLatin1Char('A')) {
+            token.field = AmPm;
+            token.width = c == QLatin1Char('A');
+            if (i + 1 < length && format.at(i + 1).toLower() == QLatin1Char('p'))
+                consumed = 2;
+            ampm = true;
+        } else {
+            // time zones and anything else unknown are left to QTime
+            if (c.isLetter())
+                d.exact = false;
+            literal += c;
+            ++i;
+            continue;
+        }
+
+        if (!literal.isEmpty()) {
+            Token text = { Literal, 0, literal };
+            d.tokens += text;
+            literal.clear();
+        }
+        d.tokens += token;
+        i += consumed;
+    }
+    if (!literal.isEmpty()) {
+        Token text = { Literal, 0, literal };
+        d.tokens += text;
+    }
+
+    // without am/pm, 'h' is a 24-hour clock just like 'H'
+    for (int i = 0; i < d.tokens.count(); ++i) {
+        if (!ampm && d.tokens.at(i).field == Hour12)
+            d.tokens[i].field = Hour;
+    }
+
+    const QLocale locale = QLocale::system();
+    d.am = locale.amText();
+    d.pm = locale.pmText();
+}
+
+QString TimeStampRenderer::render(qint64 msecs) const
+{
+    if (msecs < 0 || d.format.isEmpty())
+        return QString();
+
+    const qint64 key = d.precise ? msecs : msecs / 1000;
+    if (key == d.key)
+        return d.text;
+
+    d.key = key;
+    if (!d.exact) {
+        d.text = QDateTime::fromMSecsSinceEpoch(msecs).time().toString(d.format);
+        return d.text;
+    }
+
+    locate(msecs);
+    int time = 0;
+    if (msecs >= d.start && msecs < d.end && d.end - d.start == MSecsPerDay)
+        time = int(msecs - d.start);
+    else // a daylight saving transition, let QDateTime sort it out
+        time = QDateTime::fromMSecsSinceEpoch(msecs).time().msecsSinceStartOfDay();
+
+    const int hour = time / 3600000;
+    const int minute = time / 60000 % 60;
+    const int second = time / 1000 % 60;
+    const int msec = time % 1000;
+
+    QString text;
+    text.reserve(d.format.length() + 4);
+    foreach (const Token& token, d.tokens) {
+        switch (token.field) {
+        case Literal:
+            text += token.text;
+            break;
+        case Hour:
+            text += QString::number(hour).rightJustified(token.width, QLatin1Char('0'));
+            break;
+        case Hour12:
+            text += QString::number(hour % 12 ? hour % 12 : 12).rightJustified(token.width, QLatin1Char('0'));
+            break;
+        case Minute:
+            text += QString::number(minute).rightJustified(token.width, QLatin1Char('0'));
+            break;
+        case Second:
+            text += QString::number(second).rightJustified(token.width, QLatin1Char('0'));
+            break;
+        case MSec:
+            text += QString::number(msec).rightJustified(token.width, QLatin1Char('0'));
+            break;
+        case AmPm: {
+            const QString ap = hour < 12 ? d.am : d.pm;
+            text += token.width ? ap.toUpper() : ap.toLower();
+            break;
+        }
+        }
+    }
+    d.text = text;
+    return d.text;
+}
+
+// the local calendar day as a julian day number, or -1 if not stamped
+qint64 TimeStampRenderer::day(qint64 msecs) const
+{
+    if (msecs < 0)
+        return -1;
+    locate(msecs);
+    return d.day;
+}
+
+void TimeStampRenderer::locate(qint64 msecs) const
+{
+    if (msecs >= d.start && msecs < d.end)
+        return;
+
+    const QDate date = QDateTime::fromMSecsSinceEpoch(msecs).date();
+#if QT_VERSION >= 0x050e00
+    d.start = date.startOfDay().toMSecsSinceEpoch();
+    d.end = date.addDays(1).startOfDay().toMSecsSinceEpoch();
+#else
+    d.start = QDateTime(date).toMSecsSinceEpoch();
+    d.end = QDateTime(date.addDays(1)).toMSecsSinceEpoch();
+#endif
+    d.day = date.toJulianDay();
+}
@@ -0,0 +1,73 @@
+/*
+  Copyright (C) 2008-2016 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TIMESTAMPRENDERER_H
+#define TIMESTAMPRENDERER_H
+
+#include <QString>
+#include <QVector>
+#include "baseglobal.h"
+
+class BASE_EXPORT TimeStampRenderer
+{
+public:
+    explicit TimeStampRenderer(const QString& format = QString());
+
+    QString format() const;
+    void setFormat(const QString& format);
+
+    QString render(qint64 msecs) const;
+    qint64 day(qint64 msecs) const;
+
+private:
+    void locate(qint64 msecs) const;
+
+    enum Field { Literal, Hour, Hour12, Minute, Second, MSec, AmPm };
+
+    struct Token {
+        Field field;
+        int width;
+        QString text;
+    };
+
+    struct Private {
+        QString format;
+        bool exact;
+        bool precise;
+        QString am;
+        QString pm;
+        QVector<Token> tokens;
+        mutable qint64 key;
+        mutable QString text;
+        mutable qint64 start;
+        mutable qint64 end;
+        mutable qint64 day;
+    } d;
+};
+
+#endif // TIMESTAMPRENDERER_H
@@ -28,20 +28,24 @@
 
 #include "titlebar.h"
 #include "messageformatter.h"
+#include "nickindex.h"
 #include <QStyleOptionHeader>
 #include <QPropertyAnimation>
 #include <QStylePainter>
 #include <IrcTextFormat>
-#include <IrcUserModel>
 #include <QApplication>
 #include <QMouseEvent>
 #include <QHeaderView>
+#include <QTimerEvent>
 #include <IrcCommand>
 #include <IrcChannel>
 #include <QTreeView>
 #include <QStyle>
 #include <QMenu>
 
+// at most one refresh per frame
+static const int Interval = 16;
+
 class TitleMenu : public QMenu
 {
 public:
@@ -65,7 +69,6 @@ protected:
 TitleBar::TitleBar(QWidget* parent) : QLabel(parent)
 {
     d.buffer = 0;
-    d.model = 0;
     d.baseOffset = -1;
     d.editor = 0;
     d.formatter = new MessageFormatter(this);
@@ -88,10 +91,21 @@ TitleBar::TitleBar(QWidget* parent) : QLabel(parent)
     d.menuButton->setFocusPolicy(Qt::NoFocus);
     d.menuButton->adjustSize();
 
+    d.countLabel = new QLabel(this);
+    d.countLabel->setObjectName("count");
+    d.countLabel->setTextFormat(Qt::PlainText);
+    d.countLabel->hide();
+
     adjustSize();
     relayout();
 }
 
+TitleBar::~TitleBar()
+{
+    if (d.index)
+        d.index->release();
+}
+
 QMenu* TitleBar::menu() const
 {
     return d.menuButton->menu();
@@ -133,6 +147,7 @@ QString TitleBar::styleSheet() const
 void TitleBar::setStyleSheet(const QString& css)
 {
     d.css = css;
+    clear();
     refresh();
 }
 
@@ -166,32 +181,33 @@ void TitleBar::setBuffer(IrcBuffer* buffer)
             IrcChannel* channel = qobject_cast<IrcChannel*>(d.buffer);
             if (channel) {
                 disconnect(channel, SIGNAL(destroyed(IrcChannel*)), this, SLOT(cleanup()));
-                disconnect(channel, SIGNAL(topicChanged(QString)), this, SLOT(refresh()));
-                disconnect(channel, SIGNAL(modeChanged(QString)), this, SLOT(refresh()));
-                if (d.model)
-                    d.model->setChannel(0);
+                disconnect(channel, SIGNAL(topicChanged(QString)), this, SLOT(scheduleRefresh()));
+                disconnect(channel, SIGNAL(modeChanged(QString)), this, SLOT(scheduleRefresh()));
+                if (d.index) {
+                    disconnect(d.index, SIGNAL(changed()), this, SLOT(scheduleRefresh()));
+                    d.index->release();
+                }
+                d.index = 0;
             } else {
                 disconnect(d.buffer, SIGNAL(destroyed(IrcBuffer*)), this, SLOT(cleanup()));
             }
-            disconnect(d.buffer, SIGNAL(titleChanged(QString)), this, SLOT(refresh()));
+            disconnect(d.buffer, SIGNAL(titleChanged(QString)), this, SLOT(scheduleRefresh()));
         }
         d.buffer = buffer;
         if (d.buffer) {
             IrcChannel* channel = qobject_cast<IrcChannel*>(d.buffer);
             if (channel) {
                 connect(channel, SIGNAL(destroyed(IrcChannel*)), this, SLOT(cleanup()));
-                connect(channel, SIGNAL(topicChanged(QString)), this, SLOT(refresh()));
-                connect(channel, SIGNAL(modeChanged(QString)), this, SLOT(refresh()));
-                if (!d.model) {
-                    d.model = new IrcUserModel(this);
-                    connect(d.model, SIGNAL(countChanged(int)), this, SLOT(refresh()));
-                }
-                d.model->setChannel(channel);
+                connect(channel, SIGNAL(topicChanged(QString)), this, SLOT(scheduleRefresh()));
+                connect(channel, SIGNAL(modeChanged(QString)), this, SLOT(scheduleRefresh()));
+                d.index = NickIndex::acquire(channel);
+                connect(d.index, SIGNAL(changed()), this, SLOT(scheduleRefresh()));
             } else {
                 connect(d.buffer, SIGNAL(destroyed(IrcBuffer*)), this, SLOT(cleanup()));
             }
-            connect(d.buffer, SIGNAL(titleChanged(QString)), this, SLOT(refresh()));
+            connect(d.buffer, SIGNAL(titleChanged(QString)), this, SLOT(scheduleRefresh()));
         }
+        d.formatter->setBuffer(buffer);
         collapse();
         refresh();
     }
@@ -289,6 +305,14 @@ void TitleBar::resizeEvent(QResizeEvent* event)
     emit offsetChanged(offset());
 }
 
+void TitleBar::timerEvent(QTimerEvent* event)
+{
+    if (event->timerId() == d.timer.timerId())
+        refresh();
+    else
+        QLabel::timerEvent(event);
+}
+
 void TitleBar::relayout()
 {
     QRect r = d.menuButton->rect();
@@ -299,38 +323,71 @@ void TitleBar::relayout()
     option.initFrom(this);
     option.rect.setRight(r.left() - 1);
     QRect ser = style()->subElementRect(QStyle::SE_HeaderLabel, &option, this);
+
+    // the user count sits at the end of the first line, next to the menu
+    if (!d.countLabel->isHidden()) {
+        QRect cr(QPoint(), d.countLabel->sizeHint());
+        cr.moveTopRight(QPoint(ser.right(), topMargin() + ser.y()));
+        d.countLabel->setGeometry(cr);
+#if QT_VERSION >= 0x050b00
+        ser.setRight(cr.left() - fontMetrics().horizontalAdvance(' '));
+#else
+        ser.setRight(cr.left() - fontMetrics().width(' '));
+#endif
+    }
     setContentsMargins(ser.x(), topMargin() + ser.y(), width() - ser.x() - ser.width(), height() - ser.y() - ser.height());
 }
 
 void TitleBar::cleanup()
 {
     d.buffer = 0;
+    d.formatter->setBuffer(0);
     refresh();
 }
 
+// user count churn in large channels arrives in bursts, it is folded
+// into one refresh per frame
+void TitleBar::scheduleRefresh()
+{
+    if (!d.timer.isActive())
+        d.timer.start(Interval, this);
+}
+
+// the count has a label of its own, so that joins and parts do not make
+// the rich text label re-parse and re-lay out the topic
 void TitleBar::refresh()
 {
-    clear();
+    d.timer.stop();
 
+    const QString count = d.index && d.index->count() > 0 ? QString::number(d.index->count()) : QString();
+    if (count != d.countLabel->text()) {
+        d.countLabel->setText(count);
+        d.countLabel->setHidden(count.isEmpty());
+        relayout();
+    }
+
+    // the topic is formatted against the channel's nicks, and only has
+    // to be formatted again when one of the nicks it mentions comes or goes
     IrcChannel* channel = qobject_cast<IrcChannel*>(d.buffer);
-    QString title = d.buffer ? d.buffer->title() : QString();
-    QString topic = channel ? d.formatter->formatText(channel->topic()) : QString();
+    const QString raw = channel ? channel->topic() : QString();
+    const QStringList nicks = d.formatter->matchedNicks(raw);
+    if (raw != d.topic || nicks != d.nicks || d.html.isNull()) {
+        d.topic = raw;
+        d.nicks = nicks;
+        d.html = d.formatter->formatText(raw);
+    }
 
-    QStringList info;
+    QString title = d.buffer ? d.buffer->title() : QString();
+    QString text = title;
 //    if (channel && !channel->mode().isEmpty())
-//        info += channel->mode();
-    if (d.model && d.model->count() > 0)
-        info += QString::number(d.model->count());
-
-    if (info.isEmpty() && topic.isEmpty())
-        setText(title);
-    else if (topic.isEmpty())
-        setText(tr("%1 (%2)").arg(title).arg(info.join(tr(", "))));
-    else if (info.isEmpty())
-        setText(tr("%1: %2").arg(title).arg(topic));
-    else
-        setText(tr("%1 (%2): %3").arg(title).arg(info.join(tr(", "))).arg(topic));
+//        text = tr("%1 (%2)").arg(title).arg(channel->mode());
+    if (!d.html.isEmpty())
+        text = tr("%1: %2").arg(text).arg(d.html);
+
+    if (text == QLabel::text())
+        return;
 
+    setText(text);
     foreach (QTextDocument* doc, findChildren<QTextDocument*>())
         doc->setDefaultStyleSheet(d.css);
 }
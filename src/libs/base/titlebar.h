@@ -30,12 +30,15 @@
 #define TITLEBAR_H
 
 #include <QLabel>
+#include <QPointer>
+#include <QStringList>
+#include <QBasicTimer>
 #include <QTextEdit>
 #include <QToolButton>
 #include "baseglobal.h"
 
 class IrcBuffer;
-class IrcUserModel;
+class NickIndex;
 class MessageFormatter;
 
 class BASE_EXPORT TitleBar : public QLabel
@@ -45,6 +48,7 @@ class BASE_EXPORT TitleBar : public QLabel
 
 public:
     explicit TitleBar(QWidget* parent = 0);
+    ~TitleBar();
 
     IrcBuffer* buffer() const;
     QString topic() const;
@@ -78,11 +82,13 @@ protected:
     void mouseDoubleClickEvent(QMouseEvent* event);
     void paintEvent(QPaintEvent* event);
     void resizeEvent(QResizeEvent* event);
+    void timerEvent(QTimerEvent* event);
 
 private slots:
     void relayout();
     void cleanup();
     void refresh();
+    void scheduleRefresh();
     void edit();
 
 private:
@@ -94,8 +100,13 @@ private:
         IrcBuffer* buffer;
         QTextEdit* editor;
         QToolButton* menuButton;
+        QLabel* countLabel;
         MessageFormatter* formatter;
-        IrcUserModel* model;
+        QPointer<NickIndex> index;
+        QBasicTimer timer;
+        QString topic;
+        QStringList nicks;
+        QString html;
     } d;
 };
 